@@ -0,0 +1,12 @@
+#ifndef EMERGENCY_STOP_NODE_H
+#define EMERGENCY_STOP_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Publishes /emergency_stop from the lidar until ROS shuts down or running is cleared,
+// the callbacks of nh are called from queue on the calling thread.
+void runEmergencyStopNode(ros::NodeHandle& nh, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // EMERGENCY_STOP_NODE_H
@@ -1,83 +1,147 @@
 #include "ros/ros.h"
 #include "std_msgs/Bool.h"
 #include "sensor_msgs/LaserScan.h"
+#include "geometry_msgs/Twist.h"
 #include "math.h"
 #include "visualization_msgs/Marker.h"
+#include <ros/callback_queue.h>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 
-class LidarListener
-{
-public:
-    std::vector<float> ranges;
-    float angle_increment;
+#include <emergency_stop_node.h>
+#include <scan_preprocessor.h>
+#include <safety_zone.h>
 
-    float range_min;
-    float range_max;
+// The area that has to stay clear: an ellipse in the laser frame.
+struct Footprint
+{
+    float radius_x;
+    float radius_y;
+    float offset_x;
+    float offset_y;
 
-    void callback(const sensor_msgs::LaserScan::ConstPtr& msg);
+    Footprint(): radius_x(0.27), radius_y(0.17), offset_x(0.1), offset_y(0) {};
 };
 
-void LidarListener::callback(const sensor_msgs::LaserScan::ConstPtr& msg)
+// For every beam of a scan layout the ranges that end in the footprint, [inside_min, inside_max].
+// Beams that miss the footprint get an empty interval.
+class FootprintTable
 {
-    ranges = msg->ranges;
-    angle_increment = msg->angle_increment;
-
-    range_min = msg->range_min;
-    range_max = msg->range_max;
-}
-
-
-bool violation(float range, float angle) {
+public:
+    std::shared_ptr<const BeamTable> beams;
+    std::vector<float> inside_min;
+    std::vector<float> inside_max;
 
-    float x = range * cos(angle);
-    float y = range * sin(angle);
+    void build(const Footprint& footprint, const std::shared_ptr<const BeamTable>& table);
+};
 
-    float radius_x = 0.27;
-    float radius_y = 0.17;
+void FootprintTable::build(const Footprint& footprint, const std::shared_ptr<const BeamTable>& table)
+{
+    beams = table;
+    inside_min.assign(table->size, INFINITY);
+    inside_max.assign(table->size, -INFINITY);
+    float ax = 1/(footprint.radius_x*footprint.radius_x);
+    float ay = 1/(footprint.radius_y*footprint.radius_y);
+    for (size_t i = 0; i < table->size; i++) {
+        // the point at range r, r*(c, s) from the laser, is in the ellipse
+        // where a*r^2 + b*r + c <= 0
+        double c = table->cosAngles[i];
+        double s = table->sinAngles[i];
+        double qa = c*c*ax + s*s*ay;
+        double qb = -2*(c*footprint.offset_x*ax + s*footprint.offset_y*ay);
+        double qc = footprint.offset_x*footprint.offset_x*ax + footprint.offset_y*footprint.offset_y*ay - 1;
+        double discriminant = qb*qb - 4*qa*qc;
+        if (discriminant < 0) {
+            continue;
+        }
+        double high = (-qb + sqrt(discriminant))/(2*qa);
+        if (high < 0) {
+            continue;
+        }
+        inside_min[i] = std::max(0.0, (-qb - sqrt(discriminant))/(2*qa));
+        inside_max[i] = high;
+    }
+}
 
-    float offset_x = 0.1;
-    float offset_y = 0;
+// Checks every scan as it comes in and publishes /emergency_stop right away. The zone is
+// the footprint and, on top of it, what the robot covers until it stops from the last command.
+class LidarListener
+{
+public:
+    ros::Publisher stop_pub;
+    int violation_limit;
+
+    LidarListener(const Footprint& p_footprint, int p_violation_limit, double robot_radius):
+        violation_limit(p_violation_limit),
+        footprint(p_footprint),
+        zone(robot_radius),
+        command_lin(0),
+        command_ang(0),
+        latency_count(0),
+        latency_sum(0),
+        latency_max(0) {};
 
-    float location = pow((x - offset_x), 2)/pow(radius_x, 2) +
-                    pow((y - offset_y), 2)/pow(radius_y, 2);
+    void callback(const sensor_msgs::LaserScan::ConstPtr& msg);
+    void twistCallback(const geometry_msgs::Twist::ConstPtr& msg);
+
+private:
+    // in the laser frame: beam i points at pi - i*angle_increment
+    static ScanGeometry geometry() { return ScanGeometry(M_PI, -1, 0, 0); }
+    Footprint footprint;
+    FootprintTable table;
+    SafetyZone zone;
+    double command_lin;
+    double command_ang;
+
+    // scan stamp to stop published, reported every latency_period scans
+    static const int latency_period = 100;
+    int latency_count;
+    double latency_sum;
+    double latency_max;
+};
 
-    if(location <= 1) {
-        ROS_INFO("Violation point [x, y, angle]: [%f, %f, %f]", x, y, angle);
-        return true;
+void LidarListener::callback(const sensor_msgs::LaserScan::ConstPtr& msg)
+{
+    if (!table.beams || !table.beams->matches(geometry(), msg->ranges.size(), msg->angle_increment)) {
+        table.build(footprint, std::make_shared<BeamTable>(geometry(), msg->ranges.size(), msg->angle_increment));
+        // the braking trajectory is in base_link, the beams are the same
+        zone.build(std::make_shared<BeamTable>(ScanGeometry(), msg->ranges.size(), msg->angle_increment),
+                   table.inside_min, table.inside_max);
     }
 
-    return false;
-}
+    int violations = zone.violations(msg->ranges, command_lin, command_ang);
 
+    std_msgs::Bool stop;
+    stop.data = violations > violation_limit;
+    stop_pub.publish(stop);
 
-int number_violations(std::vector<float> ranges, float angle_increment) {
-    int nr_violations = 0;
-    float current_angle = M_PI;
+    if (stop.data) {
+        ROS_WARN_THROTTLE(1, "Emergency stop, %d beams in the footprint", violations);
+    }
 
-    for(int i = 0; i < ranges.size(); i++) {
-        if(!isinf(ranges[i])) {
-            if(violation(ranges[i], current_angle)) {
-                nr_violations++;
-            }
+    if (!msg->header.stamp.isZero()) {
+        double latency = (ros::Time::now() - msg->header.stamp).toSec();
+        latency_sum += latency;
+        latency_max = std::max(latency_max, latency);
+        latency_count++;
+        if (latency_count == latency_period) {
+            ROS_INFO("Scan to stop latency over %d scans: mean %.1f ms, max %.1f ms",
+                     latency_count, latency_sum/latency_count*1000, latency_max*1000);
+            latency_count = 0;
+            latency_sum = 0;
+            latency_max = 0;
         }
-        current_angle -= angle_increment;
     }
-
-    ROS_INFO("Number of violations: %d", nr_violations);
-
-    return nr_violations;
 }
 
-bool danger(int threshold, std::vector<float> ranges, float angle_increment) {
-
-    int violations = number_violations(ranges, angle_increment);
-
-    if(violations > threshold) {
-        return true;
-    }
-    return false;
+void LidarListener::twistCallback(const geometry_msgs::Twist::ConstPtr& msg)
+{
+    command_lin = msg->linear.x;
+    command_ang = msg->angular.z;
 }
 
-void showRestrictedArea(ros::Publisher vis_pub) {
+void showRestrictedArea(ros::Publisher vis_pub, const Footprint& footprint) {
 
     visualization_msgs::Marker marker;
     marker.header.frame_id = "laser";
@@ -86,15 +150,15 @@ void showRestrictedArea(ros::Publisher vis_pub) {
     marker.id = 0;
     marker.type = visualization_msgs::Marker::CYLINDER;
     marker.action = visualization_msgs::Marker::ADD;
-    marker.pose.position.x = 0.1;
-    marker.pose.position.y = 0;
+    marker.pose.position.x = footprint.offset_x;
+    marker.pose.position.y = footprint.offset_y;
     marker.pose.position.z = 0;
     marker.pose.orientation.x = 0.0;
     marker.pose.orientation.y = 0.0;
     marker.pose.orientation.z = 0.0;
     marker.pose.orientation.w = 1.0;
-    marker.scale.x = 0.27*2;
-    marker.scale.y = 0.17*2;
+    marker.scale.x = footprint.radius_x*2;
+    marker.scale.y = footprint.radius_y*2;
     marker.scale.z = 0.1;
     marker.color.a = 0.5; // Don't forget to set the alpha!
     marker.color.r = 0.0;
@@ -105,47 +169,30 @@ void showRestrictedArea(ros::Publisher vis_pub) {
 }
 
 
-int main(int argc, char **argv) {
+void runEmergencyStopNode(ros::NodeHandle& nh, ros::CallbackQueue& queue, const std::atomic<bool>& running) {
 
     int violation_limit = 10;
+    Footprint footprint;
 
-    ros::init(argc, argv, "emergency_stop_node");
-
-    ros::NodeHandle nh;
-
-    ros::Publisher stop_pub = nh.advertise<std_msgs::Bool>("/emergency_stop", 1000);
+    double robot_radius = 0.18;
+    LidarListener lidar_listen(footprint, violation_limit, robot_radius);
+    lidar_listen.stop_pub = nh.advertise<std_msgs::Bool>("/emergency_stop", 1000);
 
     ros::Publisher vis_pub = nh.advertise<visualization_msgs::Marker>("restriction_marker", 0 );
 
+    ros::Subscriber lidar_sub = nh.subscribe("/scan", 1, &LidarListener::callback, &lidar_listen);
+    ros::Subscriber twist_sub = nh.subscribe("/motor_controller/twist", 1, &LidarListener::twistCallback, &lidar_listen);
 
-    LidarListener lidar_listen;
-    ros::Subscriber lidar_sub = nh.subscribe("/scan", 1000, &LidarListener::callback, &lidar_listen);
-
-    ros::Rate loop_rate(10);
-
-    while (ros::ok())
+    // the stop is published from the scan callback, the loop only waits for scans
+    // (at most 0.1 s, to notice shutdown) and refreshes the marker
+    ros::Time last_marker;
+    while (ros::ok() && running)
     {
-        bool stop = false;
+        queue.callAvailable(ros::WallDuration(0.1));
 
-        if (danger(violation_limit, lidar_listen.ranges, lidar_listen.angle_increment)) {
-            stop = true;
+        if ((ros::Time::now() - last_marker).toSec() >= 0.1) {
+            showRestrictedArea(vis_pub, footprint);
+            last_marker = ros::Time::now();
         }
-
-
-
-        showRestrictedArea(vis_pub);
-
-        std_msgs::Bool msg;
-
-        msg.data = stop;
-
-        stop_pub.publish(msg);
-
-        ros::spinOnce();
-
-        loop_rate.sleep();
-
     }
-
-    return 0;
 }
@@ -0,0 +1,16 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <atomic>
+
+#include <emergency_stop_node.h>
+
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "emergency_stop_node");
+
+    ros::NodeHandle nh;
+    std::atomic<bool> running(true);
+    runEmergencyStopNode(nh, *ros::getGlobalCallbackQueue(), running);
+
+    return 0;
+}
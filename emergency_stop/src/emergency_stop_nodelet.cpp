@@ -0,0 +1,42 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <atomic>
+#include <thread>
+
+#include <emergency_stop_node.h>
+
+namespace emergency_stop {
+
+// emergency_stop_node in a nodelet manager, it shares /scan with the other
+// nodelets instead of deserialising its own copy. The loop has its own thread
+// and callback queue.
+class EmergencyStopNodelet : public nodelet::Nodelet {
+public:
+    EmergencyStopNodelet(): running(false) {};
+    ~EmergencyStopNodelet() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+private:
+    ros::CallbackQueue queue;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    virtual void onInit() {
+        ros::NodeHandle nh = getNodeHandle();
+        nh.setCallbackQueue(&queue);
+        running = true;
+        worker = std::thread([this, nh]() mutable {
+            runEmergencyStopNode(nh, queue, running);
+        });
+    }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(emergency_stop::EmergencyStopNodelet, nodelet::Nodelet)
@@ -0,0 +1,12 @@
+#ifndef FILTER_NODE_H
+#define FILTER_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Runs the particle filter until ROS shuts down or running is cleared.
+// queue has to be the callback queue of n, it is served between the filter steps.
+void runFilterNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // FILTER_NODE_H
@@ -19,7 +19,12 @@ struct Particle{
 
 };
 
-void getParticlesWeight(vector<Particle> &particles, LocalizationGlobalMap& map, vector<pair<float, float>>& laser_data, float max_distance, float lidar_x, float lidar_y);
+class ParticleSet;
+
+void getParticlesWeight(ParticleSet &particles, LocalizationGlobalMap& map, vector<pair<float, float>>& laser_data, float max_distance, float lidar_x, float lidar_y);
+
+// the likelihood field model: every hit scored by the cell it lands in (map.buildLikelihoodField)
+void getParticlesLikelihood(ParticleSet &particles, LocalizationGlobalMap& map, vector<pair<float, float>>& laser_data, float max_distance, float lidar_x, float lidar_y);
 
 float calculateWeight(LocalizationGlobalMap& map, float &translated_particle_x, float &translated_particle_y, vector<pair<float, float>> &laser_data, float &max_distance, float &particle_theta);
 
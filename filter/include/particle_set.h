@@ -0,0 +1,81 @@
+#ifndef PARTICLE_SET_H
+#define PARTICLE_SET_H 1
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdlib.h>
+
+#include <measurements.h>
+
+using namespace std;
+
+// Allocator of vectors the SIMD kernels load from with aligned loads.
+template <class T, size_t Align>
+struct AlignedAllocator {
+    typedef T value_type;
+    template <class U> struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+    AlignedAllocator() {}
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t n) {
+        void* p = 0;
+        if (posix_memalign(&p, Align, n*sizeof(T)) != 0) {
+            throw bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { free(p); }
+};
+template <class T, class U, size_t Align>
+bool operator==(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&) { return true; }
+template <class T, class U, size_t Align>
+bool operator!=(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&) { return false; }
+
+typedef vector<float, AlignedAllocator<float, 32> > AlignedFloats;
+
+// The particles of the filter as one array per field. The arrays are padded to a
+// multiple of lanes (8) and the kernels below run over whole blocks of them with
+// AVX2/FMA, SSE2 or plain floats, whichever the build targets (simdName()).
+// Padding particles have weight 0 and are left out of the estimate.
+class ParticleSet {
+  public:
+    AlignedFloats x;
+    AlignedFloats y;
+    AlignedFloats theta;
+    AlignedFloats weight;
+
+    ParticleSet(): count(0) { seed(1); };
+    size_t size() const { return count; }
+    void resize(size_t n);
+    Particle get(size_t i) const;
+    void set(size_t i, const Particle& p);
+    // the random streams of the motion update and the noise, one per lane
+    void seed(uint64_t value);
+
+    void setWeights(float w);
+    // moves every particle by distance along its heading and turns it by turn,
+    // with normal noise of sigmaDistance on the distance and sigmaTurn on the turn,
+    // and wraps the headings to [-pi, pi]
+    void move(float distance, float turn, float sigmaDistance, float sigmaTurn);
+    // normal noise of sigma on x, y and theta
+    void jitter(float sigma);
+    void wrapAngles();
+    // scales the weights to sum 1, returns the sum before
+    float normalise();
+    // mean position and circular mean heading of the first n particles
+    Particle estimate(size_t n) const;
+    // replaces the particles with the given ones (indices into this set)
+    void resample(const vector<int>& picks);
+
+    static const char* simdName();
+  private:
+    size_t count;
+    // xorshift128 per lane, four words
+    vector<uint32_t, AlignedAllocator<uint32_t, 32> > rng;
+    AlignedFloats scratch;
+};
+
+#endif // PARTICLE_SET_H
@@ -0,0 +1,12 @@
+#ifndef WALL_FINDER_NODE_H
+#define WALL_FINDER_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Looks for new walls until ROS shuts down or running is cleared,
+// the callbacks of n (queue) are served by the calling thread.
+void runWallFinderNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // WALL_FINDER_NODE_H
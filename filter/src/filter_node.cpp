@@ -6,6 +6,7 @@
 #include <sensor_msgs/LaserScan.h>
 #include <math.h>
 #include <functional>
+#include <algorithm>
 #include <random>
 #include <chrono>
 #include <ctime>
@@ -14,6 +15,7 @@
 #include <geometry_msgs/PoseWithCovarianceStamped.h>
 #include <geometry_msgs/Pose.h>
 #include <project_msgs/stop.h>
+#include <boost/make_shared.hpp>
 
 
 #include "std_msgs/Float32MultiArray.h"
@@ -26,6 +28,9 @@
 
 #include <localization_global_map.h>
 #include <measurements.h>
+#include <particle_set.h>
+#include <filter_node.h>
+#include <scan_preprocessor.h>
 /**
  * This tutorial demonstrates simple sending of messages over the ROS system.
  */
@@ -54,13 +59,14 @@ class FilterPublisher
     tf::TransformBroadcaster odom_broadcaster;
 
     ros::Subscriber lidar_subscriber;
-    std::vector<float> ranges;
+    std::shared_ptr<const PreprocessedScan> scan;
     float angle_increment;
     float range_min;
     float range_max;
     int _nr_measurements;
     int _nr_random_particles;
     bool _using_random_particles;
+    bool _using_likelihood_field;
     float _gaussian_particle_noise_spread;
     bool _intitialPoseReceived;
     float _start_x;
@@ -80,11 +86,11 @@ class FilterPublisher
 
     //LocalizationGlobalMap map;
 
-    FilterPublisher(float frequency, LocalizationGlobalMap newMap)
+    FilterPublisher(ros::NodeHandle& nh, float frequency, LocalizationGlobalMap newMap)
     {
         control_frequency = frequency;
         dt = 1/control_frequency;
-        n = ros::NodeHandle("~");
+        n = nh;
         int nr_particles = 500;
         int nr_measurements = 8;
         int nr_random_particles = 10;
@@ -94,6 +100,10 @@ class FilterPublisher
         float k_W = 0.5;
         bool using_random_particles = false;
         float gaussian_particle_noise_spread = 0.1;
+        bool exact_ray_casting = false;
+        std::string measurement_model = "beam";
+        int likelihood_field_measurements = 360;
+        float likelihood_field_sigma = 0.05;
          _intitialPoseReceived = false;
          map = newMap;
          _navigation_linear_speed = 0;
@@ -126,6 +136,22 @@ class FilterPublisher
             ROS_ERROR("Filter failed to detect parameter 4");
             exit(EXIT_FAILURE);
         }
+        if(!n.getParam("/filter/particle_params/exact_ray_casting",exact_ray_casting)){
+            ROS_ERROR("Filter failed to detect parameter exact_ray_casting");
+            exit(EXIT_FAILURE);
+        }
+        if(!n.getParam("/filter/particle_params/measurement_model",measurement_model)){
+            ROS_ERROR("Filter failed to detect parameter measurement_model");
+            exit(EXIT_FAILURE);
+        }
+        if(!n.getParam("/filter/particle_params/likelihood_field_measurements",likelihood_field_measurements)){
+            ROS_ERROR("Filter failed to detect parameter likelihood_field_measurements");
+            exit(EXIT_FAILURE);
+        }
+        if(!n.getParam("/filter/particle_params/likelihood_field_sigma",likelihood_field_sigma)){
+            ROS_ERROR("Filter failed to detect parameter likelihood_field_sigma");
+            exit(EXIT_FAILURE);
+        }
         if(!n.getParam("/filter/odom_noise/k_D",k_D)){
             ROS_ERROR("Filter failed to detect parameter 5");
             exit(EXIT_FAILURE);
@@ -163,6 +189,20 @@ class FilterPublisher
         ROS_INFO("Odom k_V: [%f]", k_V);
         ROS_INFO("Odom k_D: [%f]", k_D);
         ROS_INFO("Odom k_W: [%f]", k_W);
+        ROS_INFO("Particle kernels: [%s]", ParticleSet::simdName());
+        ROS_INFO("Measurement model: [%s]", measurement_model.c_str());
+        ROS_INFO("Exact ray casting: [%d]", exact_ray_casting);
+
+        _using_likelihood_field = (measurement_model == "likelihood_field");
+        if (_using_likelihood_field) {
+            // hits scored by their distance to the walls, no ray casting
+            ROS_INFO("Likelihood field measurements: [%d], sigma: [%f]", likelihood_field_measurements, likelihood_field_sigma);
+            map.buildLikelihoodField(likelihood_field_sigma, 0.8, 0.2);
+            nr_measurements = likelihood_field_measurements;
+        } else if (!exact_ray_casting) {
+            // expected ranges from a table, exact_ray_casting intersects the walls for every beam instead
+            map.buildRangeTable(0.02, 360);
+        }
         pi = 3.1416;
 
         encoding_abs_prev = std::vector<int>(2, 0);
@@ -173,6 +213,7 @@ class FilterPublisher
         //set up random
         unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
         generator = std::default_random_engine(seed);
+        particles.seed(seed);
 
         first_loop = true;
 
@@ -202,7 +243,6 @@ class FilterPublisher
 
         srand(static_cast<unsigned>(time(0)));
         particle_randomness = std::normal_distribution<float>(0.0, random_particle_spread);
-        particle_randomness2 = std::normal_distribution<float>(0.0, _gaussian_particle_noise_spread);
         _nr_measurements = nr_measurements;
         _nr_random_particles = nr_random_particles;
     }
@@ -220,7 +260,7 @@ class FilterPublisher
     void lidarCallback(const sensor_msgs::LaserScan::ConstPtr &msg)
     {
         _laserTime = msg->header.stamp;
-        ranges = msg->ranges;
+        scan = ScanPreprocessor::preprocess(msg);
         angle_increment = msg->angle_increment;
 
         range_min = msg->range_min;
@@ -277,10 +317,10 @@ class FilterPublisher
         for (int i = 0; i < _nr_particles; i++)
         {
 
-            particles[i].xPos = dist_start_x(generator);
-            particles[i].yPos = dist_start_y(generator);
-            particles[i].thetaPos = dist_start_theta(generator);
-            particles[i].weight = (float)1.0 / _nr_particles;
+            particles.x[i] = dist_start_x(generator);
+            particles.y[i] = dist_start_y(generator);
+            particles.theta[i] = dist_start_theta(generator);
+            particles.weight[i] = (float)1.0 / _nr_particles;
         }
 }
 
@@ -288,10 +328,7 @@ class FilterPublisher
     {
 
         //Reset weights
-        for (int m = 0; m < particles.size(); m++)
-        {
-            particles[m].weight = (float)1.0 / particles.size();
-        }
+        particles.setWeights((float)1.0 / particles.size());
 
         calculateVelocityAndNoise();
 
@@ -299,25 +336,13 @@ class FilterPublisher
         {
 
             //update according to odom
-            for (int m = 0; m < particles.size(); m++)
-            {
-                sample_motion_model(particles[m]);
-            }
+            sample_motion_model();
             //update weights according to measurements
 
             measurement_model();
 
-            float weight_sum = 0.0;
-            for (int m = 0; m < particles.size(); m++)
-            {
-                weight_sum += particles[m].weight;
-            }
-
             // Normalize weights here
-            for (int i = 0; i < particles.size(); i++)
-            {
-                particles[i].weight = particles[i].weight / weight_sum;
-            }
+            particles.normalise();
 
             if(_using_random_particles){
                 resampleParticlesWithRandomParticles();
@@ -332,93 +357,59 @@ class FilterPublisher
     }
 
     Particle getPositionEstimation(){
-        float x_estimate = 0;
-        float y_estimate = 0;
-        float theta_estimate = 0;
-        float sinPos;
-        float cosPos;
-        for (int m = 0; m < particles.size() - _nr_random_particles; m++)
-        {
-            x_estimate += particles[m].xPos;
-            y_estimate += particles[m].yPos;
-            sinPos +=  sin(particles[m].thetaPos);
-            cosPos +=  cos(particles[m].thetaPos);
+        // mean position and circular mean heading, without the random particles at the end
+        return particles.estimate(particles.size() - _nr_random_particles);
+    }
 
+    // n particles drawn by weight (multinomial), indices into particles
+    std::vector<int> drawParticles(int n)
+    {
+        cumulative_weights.resize(particles.size());
+        float cumulativeProb = 0;
+        for (int m = 0; m < particles.size(); m++)
+        {
+            cumulativeProb += particles.weight[m];
+            cumulative_weights[m] = cumulativeProb;
         }
-        Particle p;
-        p.xPos = x_estimate/(particles.size() - _nr_random_particles);
-        p.yPos = y_estimate/(particles.size() - _nr_random_particles);
-        p.thetaPos = atan2(sinPos, cosPos);
-
-        return p;
-
+        std::vector<int> picks(n);
+        for (int i = 0; i < n; i++)
+        {
+            float rand_num = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX));
+            // the first particle whose cumulative weight reaches rand_num
+            int j = std::lower_bound(cumulative_weights.begin(), cumulative_weights.end(), rand_num) - cumulative_weights.begin();
+            picks[i] = std::min(j, (int)particles.size() - 1);
+        }
+        return picks;
     }
 
     void resampleParticlesWithRandomParticles()
     {
-        float rand_num;
-        float cumulativeProb;
-        int j;
-        std::vector<Particle> temp_vec;
-        for (int i = 0; i < (particles.size() - _nr_random_particles); i++)
-        {
-            j = 0;
-            cumulativeProb = particles[0].weight;
-            rand_num = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX));
-
-            while ((cumulativeProb < rand_num) && j<particles.size()-1)
-            {
-                j++;
-                cumulativeProb += particles[j].weight;
-            }
-
-            temp_vec.push_back(particles[j]);
-        }
+        int nr_drawn = particles.size() - _nr_random_particles;
+        std::vector<int> picks = drawParticles(nr_drawn);
 
         //add random particle
         int v1;
         particle_randomness(generator);
         for (int i = 0; i < _nr_random_particles; i++)
         {
-            v1 = rand() % temp_vec.size();
-            Particle p = temp_vec[v1];
-            p.xPos += particle_randomness(generator);;
-            p.yPos += particle_randomness(generator);;
-            p.thetaPos += particle_randomness(generator);;
-            temp_vec.push_back(p);
+            v1 = rand() % nr_drawn;
+            picks.push_back(picks[v1]);
         }
 
-        particles.swap(temp_vec);
+        particles.resample(picks);
+        for (int i = nr_drawn; i < particles.size(); i++)
+        {
+            particles.x[i] += particle_randomness(generator);
+            particles.y[i] += particle_randomness(generator);
+            particles.theta[i] += particle_randomness(generator);
+        }
     }
 
     // WORKS VERY BAD, WHY?
     void resampleParticlesWithGaussianNoise()
     {
-        float rand_num;
-        float cumulativeProb;
-        int j;
-        std::vector<Particle> temp_vec;
-        for (int i = 0; i < (particles.size()); i++)
-        {
-            j = 0;
-            cumulativeProb = particles[0].weight;
-            rand_num = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX));
-
-            while ((cumulativeProb < rand_num) && j<particles.size()-1)
-            {
-                j++;
-                cumulativeProb += particles[j].weight;
-            }
-
-            temp_vec.push_back(particles[j]);
-        }
-        
-        particles.swap(temp_vec);
-        for(int i = 0; i<particles.size(); i++){
-            particles[i].xPos += particle_randomness2(generator);
-            particles[i].yPos += particle_randomness2(generator);
-            particles[i].thetaPos += particle_randomness2(generator);
-        }
+        particles.resample(drawParticles(particles.size()));
+        particles.jitter(_gaussian_particle_noise_spread);
     }
 
     void calculateVelocityAndNoise()
@@ -443,29 +434,16 @@ class FilterPublisher
         linear_v = (_wheel_r / 2) * (dphi_dt[1] + dphi_dt[0]);
         angular_w = (_wheel_r / _base_d) * (dphi_dt[1] - dphi_dt[0]);
 
-        dist_D = std::normal_distribution<float>(0.0, pow((linear_v * dt*_k_D), 2));
-        dist_V = std::normal_distribution<float>(0.0, pow((linear_v * dt*_k_V), 2));
-        dist_W = std::normal_distribution<float>(0.0, pow((angular_w * dt*_k_W), 2));
+        sigma_D = pow((linear_v * dt*_k_D), 2);
+        sigma_V = pow((linear_v * dt*_k_V), 2);
+        sigma_W = pow((angular_w * dt*_k_W), 2);
     }
 
-    void sample_motion_model(Particle &p)
+    void sample_motion_model()
     {
-        float noise_D = dist_D(generator);
-        float noise_V = dist_V(generator);
-        float noise_W = dist_W(generator);
-
-        p.xPos += (linear_v * dt + noise_D) * cos(p.thetaPos);
-        p.yPos += (linear_v * dt + noise_D) * sin(p.thetaPos);
-        p.thetaPos += (angular_w * dt + noise_W) + noise_V;
-
-        if (p.thetaPos > pi)
-        {
-            p.thetaPos = p.thetaPos - 2 * pi;
-        }
-        if (p.thetaPos < -pi)
-        {
-            p.thetaPos = p.thetaPos + 2 * pi;
-        }
+        // the V and W noise both turn the particle, one draw of their combined spread
+        float sigma_turn = sqrt(sigma_V*sigma_V + sigma_W*sigma_W);
+        particles.move(linear_v * dt, angular_w * dt, sigma_D, sigma_turn);
 
         // One alternative would be to se TF Matrix to translate p to lidar_link
     }
@@ -475,42 +453,23 @@ class FilterPublisher
         //Sample the measurements
         float lidar_x = -0.03;
         float lidar_y = 0.0;
-        int step_size = (ranges.size() / _nr_measurements);
-        std::vector<pair<float, float>> sampled_measurements;
-        float start_angle = -pi/2;
         float max_distance = 3.0;
-        float range;
-        float angle = 0;
 
-        int i = 0;
-
-        while (i < ranges.size())
+        if (!scan)
         {
-            angle = (i * angle_increment) + start_angle;
-            range = ranges[i];
-
-            int j = 1;
-            while(std::isinf(range)) {
-                range = ranges[i + j];
-                angle += angle_increment;
-                j++;
-            }
-            
-            if (range > max_distance)
-            {
-                range = max_distance;
-            }
-
-            
-            std::pair<float, float> angle_measurement(angle, range);
-            sampled_measurements.push_back(angle_measurement);
-            i = i + step_size;
+            return;
         }
+        // the first beam with a return in each of _nr_measurements strides
+        std::vector<pair<float, float>> sampled_measurements = scan->sampleMeasurements(_nr_measurements, max_distance);
 
-        if (ranges.size() > 0)
+        if (sampled_measurements.size() > 0)
         {
 
-            getParticlesWeight(particles, map, sampled_measurements, max_distance, lidar_x, lidar_y);
+            if (_using_likelihood_field) {
+                getParticlesLikelihood(particles, map, sampled_measurements, max_distance, lidar_x, lidar_y);
+            } else {
+                getParticlesWeight(particles, map, sampled_measurements, max_distance, lidar_x, lidar_y);
+            }
         }
     }
 
@@ -554,7 +513,8 @@ class FilterPublisher
         odom_msg.twist.twist.linear.y = vy;
         odom_msg.twist.twist.angular.z = angular_w;
 
-        filter_publisher.publish(odom_msg);
+        // published as a pointer, nodelets in the same manager get it without serialisation
+        filter_publisher.publish(boost::make_shared<nav_msgs::Odometry>(odom_msg));
 
     }
 
@@ -562,38 +522,9 @@ class FilterPublisher
     void collect_measurements(std::vector<std::pair<float, float>> &sampled_measurements)
     {
         int nr_measurements_used = 8;
-        int step_size = (ranges.size() / nr_measurements_used);
-        float start_angle = -pi/2;
         float max_distance = 3.0;
-        float range;
-        float angle = 0;
-
-        int i = 0;
 
-        while (i < ranges.size())
-        {
-            angle = (i * angle_increment) + start_angle;
-            range = ranges[i];
-
-            int j = 1;
-            while(std::isinf(range)) {
-                range = ranges[i + j];
-                angle += angle_increment;
-                j++;
-            }
-            
-            if (range > max_distance)
-            {
-                range = max_distance;
-            }
-
-            
-            ROS_INFO("Range: [%f]", range);
-            ROS_INFO("Angle: [%f]", angle);
-            std::pair<float, float> angle_measurement(angle, range);
-            sampled_measurements.push_back(angle_measurement);
-            i = i + step_size;
-        }
+        sampled_measurements = scan->sampleMeasurements(nr_measurements_used, max_distance);
 
         ROS_INFO("sampled measurements  [%lu]", sampled_measurements.size());
 
@@ -655,8 +586,8 @@ class FilterPublisher
         for (int i = 0; i < particles.size(); i++)
         {
 
-            particle.pose.position.x = particles[i].xPos;
-            particle.pose.position.y = particles[i].yPos;
+            particle.pose.position.x = particles.x[i];
+            particle.pose.position.y = particles.y[i];
 
             // Set the scale of the marker -- 1x1x1 here means 1m on a side
             particle.scale.y = weight;
@@ -730,12 +661,12 @@ class FilterPublisher
     std::vector<int> encoding_abs_new;
     std::vector<float> encoding_delta;
     std::default_random_engine generator;
-    std::normal_distribution<float> dist_D;
-    std::normal_distribution<float> dist_V;
-    std::normal_distribution<float> dist_W;
+    float sigma_D;
+    float sigma_V;
+    float sigma_W;
     std::normal_distribution<float> particle_randomness;
-    std::normal_distribution<float> particle_randomness2;
-    std::vector<Particle> particles;
+    ParticleSet particles;
+    std::vector<float> cumulative_weights;
 
     float _wheel_r;
     float _base_d;
@@ -752,7 +683,7 @@ class FilterPublisher
     float STUCK_TRESHOLD_DISTANCE;
 };
 
-int main(int argc, char **argv)
+void runFilterNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running)
 {
 
     ROS_INFO("Spin!");
@@ -764,13 +695,12 @@ int main(int argc, char **argv)
     std::string _filename_map = homePath+"/catkin_ws/src/automated_travel_entity/filter/maps/lab_maze_2017.txt";
     float cellSize = 0.01;
 
-    ros::init(argc, argv, "filter_publisher");
     ROS_INFO("Creating map");
     LocalizationGlobalMap map(_filename_map, cellSize);
     ROS_INFO("Map created!");
 
 
-    FilterPublisher filter(frequency, map);
+    FilterPublisher filter(n, frequency, map);
 
 
     ros::Rate loop_rate(frequency);
@@ -791,7 +721,7 @@ int main(int argc, char **argv)
     vector<float> linear_v_vec;
     vector<bool> motherWantsToMove_vec;
     int count = 0;
-    while (filter.n.ok())
+    while (filter.n.ok() && running)
     {
 
 
@@ -818,11 +748,9 @@ int main(int argc, char **argv)
 
         }
 
-        ros::spinOnce();
+        queue.callAvailable();
 
         loop_rate.sleep();
         ++count;
     }
-
-    return 0;
 }
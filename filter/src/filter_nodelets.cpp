@@ -0,0 +1,70 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <atomic>
+#include <thread>
+
+#include <filter_node.h>
+#include <wall_finder_node.h>
+
+namespace filter {
+
+// filter_node in a nodelet manager. /scan and the odometry reach it as shared
+// pointers, its loop thread serves its own callback queue, so the callbacks
+// still run between the filter steps only.
+class FilterNodelet : public nodelet::Nodelet {
+public:
+    FilterNodelet(): running(false) {};
+    ~FilterNodelet() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+private:
+    ros::CallbackQueue queue;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    virtual void onInit() {
+        ros::NodeHandle n = getNodeHandle();
+        n.setCallbackQueue(&queue);
+        running = true;
+        worker = std::thread([this, n]() mutable {
+            runFilterNode(n, queue, running);
+        });
+    }
+};
+
+// wall_finder_node in a nodelet manager, on a thread and queue of its own.
+class WallFinderNodelet : public nodelet::Nodelet {
+public:
+    WallFinderNodelet(): running(false) {};
+    ~WallFinderNodelet() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+private:
+    ros::CallbackQueue queue;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    virtual void onInit() {
+        ros::NodeHandle n = getNodeHandle();
+        n.setCallbackQueue(&queue);
+        running = true;
+        worker = std::thread([this, n]() mutable {
+            runWallFinderNode(n, queue, running);
+        });
+    }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(filter::FilterNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(filter::WallFinderNodelet, nodelet::Nodelet)
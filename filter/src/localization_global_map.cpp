@@ -6,6 +6,8 @@
 #include <string>
 #include <cmath>
 #include <stdlib.h>
+#include <limits>
+#include <algorithm>
 
 #include <ros/ros.h>
 #include <tf/transform_datatypes.h>
@@ -16,10 +18,11 @@
 
 using namespace std;
 
-LocalizationGlobalMap::LocalizationGlobalMap(){
+LocalizationGlobalMap::LocalizationGlobalMap(): fieldStep(0), rangeCellSize(0), rangeAngleBins(0), rangeNx(0), rangeNy(0) {
 }
 
-LocalizationGlobalMap::LocalizationGlobalMap(string _filename_map, float _cellSize) {
+LocalizationGlobalMap::LocalizationGlobalMap(string _filename_map, float _cellSize):
+    fieldStep(0), rangeCellSize(0), rangeAngleBins(0), rangeNx(0), rangeNy(0) {
     ROS_INFO("Inside map");
     cellSize = _cellSize;
     createMap(_filename_map);
@@ -144,6 +147,162 @@ float LocalizationGlobalMap::getLineIntersection(float x1, float y1, float theta
 }
 
 
+// Distance from (x, y) along angle to the first wall cell of global_map, walking the
+// cells the ray crosses (Amanatides-Woo), maxRange if there is none that close.
+float LocalizationGlobalMap::castRay(double x, double y, double angle) {
+    double gx = (x - mapOffset.first)/cellSize;
+    double gy = (y - mapOffset.second)/cellSize;
+    int i = floor(gx);
+    int j = floor(gy);
+    double dx = cos(angle);
+    double dy = sin(angle);
+    int stepX = (dx > 0) ? 1 : -1;
+    int stepY = (dy > 0) ? 1 : -1;
+    // ray length (in cells) to the next vertical and horizontal cell border, and between them
+    double deltaX = (dx != 0) ? fabs(1.0/dx) : numeric_limits<double>::infinity();
+    double deltaY = (dy != 0) ? fabs(1.0/dy) : numeric_limits<double>::infinity();
+    double nextX = (dx > 0) ? (i + 1 - gx)*deltaX : (gx - i)*deltaX;
+    double nextY = (dy > 0) ? (j + 1 - gy)*deltaY : (gy - j)*deltaY;
+    double t = 0;
+    double maxCells = maxRange/cellSize;
+    while (t < maxCells) {
+        if (i < 0 || j < 0 || i >= (int)gridSize.first || j >= (int)gridSize.second) {
+            break;
+        }
+        if (global_map.get(i, j) != 0) {
+            return t*cellSize;
+        }
+        if (nextX < nextY) {
+            t = nextX;
+            nextX += deltaX;
+            i += stepX;
+        } else {
+            t = nextY;
+            nextY += deltaY;
+            j += stepY;
+        }
+    }
+    return maxRange;
+}
+
+void LocalizationGlobalMap::buildRangeTable(float tableCellSize, int angleBins) {
+    ros::WallTime start = ros::WallTime::now();
+    rangeCellSize = tableCellSize;
+    rangeAngleBins = angleBins;
+    rangeNx = ceil(mapScale.first/rangeCellSize);
+    rangeNy = ceil(mapScale.second/rangeCellSize);
+    rangeTable.assign(rangeNx*rangeNy*rangeAngleBins, 0);
+    size_t k = 0;
+    for (size_t i = 0; i < rangeNx; i++) {
+        for (size_t j = 0; j < rangeNy; j++) {
+            // from the centre of the cell, the lookups round to the nearest one
+            double x = mapOffset.first + (i + 0.5)*rangeCellSize;
+            double y = mapOffset.second + (j + 0.5)*rangeCellSize;
+            for (int a = 0; a < rangeAngleBins; a++) {
+                float range = castRay(x, y, a*2*M_PI/rangeAngleBins);
+                rangeTable[k++] = (unsigned short)lround(range*1000);
+            }
+        }
+    }
+    ROS_INFO("Range table %lu x %lu cells, %d directions, %lu kB, built in %.2f s",
+             rangeNx, rangeNy, rangeAngleBins, rangeTable.size()*sizeof(unsigned short)/1024,
+             (ros::WallTime::now() - start).toSec());
+}
+
+float LocalizationGlobalMap::getExpectedRange(float x, float y, float angle) {
+    if (rangeTable.empty()) {
+        return getLineIntersection(x, y, angle);
+    }
+    int i = floor((x - mapOffset.first)/rangeCellSize);
+    int j = floor((y - mapOffset.second)/rangeCellSize);
+    if (i < 0 || j < 0 || i >= (int)rangeNx || j >= (int)rangeNy) {
+        return maxRange;
+    }
+    int a = lround(angle*rangeAngleBins/(2*M_PI)) % rangeAngleBins;
+    if (a < 0) {
+        a += rangeAngleBins;
+    }
+    return rangeTable[((size_t)i*rangeNy + j)*rangeAngleBins + a]*0.001f;
+}
+
+// One dimension of the squared distance transform (Felzenszwalb and Huttenlocher):
+// out[q] = min over p of (q - p)^2 + in[p], the lower envelope of the parabolas of in.
+static void distanceTransform1D(const vector<float>& in, vector<float>& out, vector<int>& v, vector<float>& z) {
+    int n = in.size();
+    const float inf = numeric_limits<float>::infinity();
+    int k = -1;
+    for (int q = 0; q < n; q++) {
+        if (in[q] == inf) {
+            continue;
+        }
+        float s = -inf;
+        while (k >= 0) {
+            s = ((in[q] + q*q) - (in[v[k]] + v[k]*v[k]))/(2.0f*(q - v[k]));
+            if (s > z[k]) {
+                break;
+            }
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = (k == 0) ? -inf : s;
+        z[k + 1] = inf;
+    }
+    if (k < 0) {
+        fill(out.begin(), out.end(), inf);
+        return;
+    }
+    int j = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[j + 1] < q) {
+            j++;
+        }
+        out[q] = (q - v[j])*(q - v[j]) + in[v[j]];
+    }
+}
+
+void LocalizationGlobalMap::buildLikelihoodField(float sigma, float zHit, float zRandom) {
+    size_t nx = gridSize.first;
+    size_t ny = gridSize.second;
+    const float inf = numeric_limits<float>::infinity();
+    // squared distances in cells, along y then along x
+    vector<float> squared(nx*ny);
+    size_t n = max(nx, ny);
+    vector<float> in(n), out(n), z(n + 1);
+    vector<int> v(n);
+    in.resize(ny);
+    out.resize(ny);
+    for (size_t i = 0; i < nx; i++) {
+        for (size_t j = 0; j < ny; j++) {
+            in[j] = global_map.get(i, j) != 0 ? 0 : inf;
+        }
+        distanceTransform1D(in, out, v, z);
+        copy(out.begin(), out.end(), squared.begin() + i*ny);
+    }
+    in.resize(nx);
+    out.resize(nx);
+    for (size_t j = 0; j < ny; j++) {
+        for (size_t i = 0; i < nx; i++) {
+            in[i] = squared[i*ny + j];
+        }
+        distanceTransform1D(in, out, v, z);
+        for (size_t i = 0; i < nx; i++) {
+            squared[i*ny + j] = out[i];
+        }
+    }
+
+    // 0 on a wall, 255 where only zRandom is left
+    double best = log(zHit + zRandom);
+    fieldStep = (best - log(zRandom))/255;
+    double scale = cellSize*cellSize/(2.0*sigma*sigma);
+    likelihoodField.resize(nx*ny);
+    for (size_t k = 0; k < nx*ny; k++) {
+        double p = zHit*exp(-squared[k]*scale) + zRandom;
+        likelihoodField[k] = (unsigned char)min(255L, lround((best - log(p))/fieldStep));
+    }
+    ROS_INFO("Likelihood field %lu x %lu, sigma %.3f", nx, ny, sigma);
+}
+
 void LocalizationGlobalMap::createMap(string filename) {
 
 
@@ -191,7 +350,7 @@ void LocalizationGlobalMap::createMap(string filename) {
     cout << "Grid Size = " <<  gridSize.first << " " << gridSize.second << endl;
 
     // fill the map
-    global_map = vector<vector<unsigned char> >(gridSize.first, vector<unsigned char>(gridSize.second,0));
+    global_map = TiledGrid<unsigned char>(gridSize.first, gridSize.second, 0);
     double radius = 0.01;
 
     for (size_t i = 0; i < walls.size(); i++) {
@@ -225,18 +384,18 @@ void LocalizationGlobalMap::createMap(string filename) {
 
         if(dx == 0) {
             while (y != y1) {
-                global_map[x][y] = 1;
+                global_map.set(x, y, 1);
                 y += sy;
             }
         } else if(dy == 0) {
             while (x != x1) {
-                global_map[x][y] = 1;
+                global_map.set(x, y, 1);
                 x += sx;
             }
         } else if(dx > dy) {
             err = dx / 2.0;
             while (x != x1) {
-                global_map[x][y] = 1;
+                global_map.set(x, y, 1);
                 err -= dy;
                 if(err < 0) {
                     y += sy;
@@ -247,7 +406,7 @@ void LocalizationGlobalMap::createMap(string filename) {
         } else {
             err = dy / 2.0;
             while (y != y1) {
-                global_map[x][y] = 1;
+                global_map.set(x, y, 1);
                 err -= dx;
                 if(err < 0) {
                     x += sx;
@@ -256,8 +415,9 @@ void LocalizationGlobalMap::createMap(string filename) {
                 y += sy;
             }
         }
-        global_map[x][y] = 1;
+        global_map.set(x, y, 1);
     }
+    global_map.compress();
 }
 
 
@@ -283,7 +443,7 @@ void LocalizationGlobalMap::createOccupancyGrid() {
 
     for (size_t j = 0; j < ny; j++) {
         for (size_t i = 0; i < nx; i++) {
-            if (global_map[i][j] == 0) {
+            if (global_map.get(i, j) == 0) {
                 visualGrid.data.push_back(0);
             } else {
                 visualGrid.data.push_back(255);
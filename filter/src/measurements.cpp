@@ -7,9 +7,12 @@
 #include <functional>
 #include <chrono>
 #include <cmath>
+#include <limits>
+#include <algorithm>
 
 
 #include <measurements.h>
+#include <particle_set.h>
 
 pair<float, float> particleToLidarConversion(float &x_particle, float &y_particle, float &theta_particle, float &lidar_x, float &lidar_y)
 {
@@ -44,7 +47,7 @@ vector<pair<float, float>> calculateRealRange(LocalizationGlobalMap& map, float
     {
 
         currentAngle = laser_data[i].first + particle_theta;
-        float rangeFromMap = map.getLineIntersection(translated_particle_x, translated_particle_y, currentAngle);
+        float rangeFromMap = map.getExpectedRange(translated_particle_x, translated_particle_y, currentAngle);
 
         pair<float, float> range = make_pair(rangeFromMap, laser_data[i].second);
 
@@ -152,7 +155,7 @@ float calculateWeight(LocalizationGlobalMap& map, float &translated_particle_x,
     return weight;
 }
 
-void getParticlesWeight(vector<Particle> &particles, LocalizationGlobalMap& map, vector<pair<float, float>> &laser_data, float max_distance, float lidar_x, float lidar_y)
+void getParticlesWeight(ParticleSet &particles, LocalizationGlobalMap& map, vector<pair<float, float>> &laser_data, float max_distance, float lidar_x, float lidar_y)
 {
     float weight = 0;
 
@@ -161,11 +164,12 @@ void getParticlesWeight(vector<Particle> &particles, LocalizationGlobalMap& map,
 
     for (int p = 0; p < particles.size(); p++)
     {
-        pair<float, float> new_particle_center = particleToLidarConversion(particles[p].xPos, particles[p].yPos, particles[p].thetaPos, lidar_x, lidar_y);
+        float theta = particles.theta[p];
+        pair<float, float> new_particle_center = particleToLidarConversion(particles.x[p], particles.y[p], theta, lidar_x, lidar_y);
 
 
         if(new_particle_center.first < x_map_max_distance && new_particle_center.first > 0 && new_particle_center.second < y_map_max_distance && new_particle_center.second > 0) {
-            weight = calculateWeight(map, new_particle_center.first, new_particle_center.second, laser_data, max_distance, particles[p].thetaPos); 
+            weight = calculateWeight(map, new_particle_center.first, new_particle_center.second, laser_data, max_distance, theta); 
             
             
         } else {
@@ -173,7 +177,72 @@ void getParticlesWeight(vector<Particle> &particles, LocalizationGlobalMap& map,
         }
 
 
-        particles[p].weight = weight;
+        particles.weight[p] = weight;
+    }
+}
+
+void getParticlesLikelihood(ParticleSet &particles, LocalizationGlobalMap& map, vector<pair<float, float>> &laser_data, float max_distance, float lidar_x, float lidar_y)
+{
+    float x_map_max_distance = 2.4;
+    float y_map_max_distance = 2.4;
+
+    // beam endpoints in the lidar frame, the readings at max_distance tell nothing
+    vector<float> beam_x;
+    vector<float> beam_y;
+    for (int r = 0; r < laser_data.size(); r++)
+    {
+        if (laser_data[r].second < max_distance)
+        {
+            beam_x.push_back(laser_data[r].second * cos(laser_data[r].first));
+            beam_y.push_back(laser_data[r].second * sin(laser_data[r].first));
+        }
+    }
+
+    const unsigned char* field = map.fieldData();
+    int nx = map.gridSize.first;
+    int ny = map.gridSize.second;
+    float inv_cell = 1.0 / map.cellSize;
+    float x_offset = map.mapOffset.first;
+    float y_offset = map.mapOffset.second;
+    float max_log_weight = -numeric_limits<float>::infinity();
+
+    for (int p = 0; p < particles.size(); p++)
+    {
+        float c = cos(particles.theta[p]);
+        float s = sin(particles.theta[p]);
+        float lx = particles.x[p] + c * lidar_x - s * lidar_y;
+        float ly = particles.y[p] + s * lidar_x + c * lidar_y;
+
+        if (!(lx < x_map_max_distance && lx > 0 && ly < y_map_max_distance && ly > 0))
+        {
+            particles.weight[p] = -numeric_limits<float>::infinity();
+            continue;
+        }
+
+        // each hit costs the negative log likelihood at its cell
+        int cost = 0;
+        for (int b = 0; b < beam_x.size(); b++)
+        {
+            float gx = (lx + c * beam_x[b] - s * beam_y[b] - x_offset) * inv_cell;
+            float gy = (ly + s * beam_x[b] + c * beam_y[b] - y_offset) * inv_cell;
+            if (gx >= 0 && gy >= 0 && gx < nx && gy < ny)
+            {
+                cost += field[(int)gx * ny + (int)gy];
+            }
+            else
+            {
+                cost += 255;
+            }
+        }
+        float log_weight = -map.fieldStep * cost;
+        particles.weight[p] = log_weight;
+        max_log_weight = max(max_log_weight, log_weight);
+    }
+
+    // relative to the best particle, so that the product over hundreds of beams does not underflow
+    for (int p = 0; p < particles.size(); p++)
+    {
+        particles.weight[p] = (max_log_weight > -numeric_limits<float>::infinity()) ? exp(particles.weight[p] - max_log_weight) : 0;
     }
 }
 
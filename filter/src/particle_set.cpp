@@ -0,0 +1,448 @@
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+#include <particle_set.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Lanes the arrays are padded to and the random streams are kept for, the widest kernel.
+static const size_t lanes = 8;
+
+// The operations the kernels are written with, for one float (the fallback and the
+// tails of the reductions) and for SSE2 and AVX2 registers. I holds 32-bit integers,
+// masks are all ones or all zeros per lane.
+struct ScalarOps {
+    typedef float F;
+    typedef uint32_t I;
+    static const int width = 1;
+
+    static F set1(float a) { return a; }
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F a) { *p = a; }
+    static I set1i(uint32_t a) { return a; }
+    static I loadi(const uint32_t* p) { return *p; }
+    static void storei(uint32_t* p, I a) { *p = a; }
+
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a*b; }
+    static F fma(F a, F b, F c) { return a*b + c; }
+    static F sqrt(F a) { return sqrtf(a); }
+    static F round(F a) { return nearbyintf(a); }
+    static I toInt(F a) { return (uint32_t)(int32_t)nearbyintf(a); }
+    static F toFloat(I a) { return (float)(int32_t)a; }
+
+    static I andi(I a, I b) { return a & b; }
+    static I xori(I a, I b) { return a ^ b; }
+    static I ori(I a, I b) { return a | b; }
+    static I addi(I a, I b) { return a + b; }
+    static I subi(I a, I b) { return a - b; }
+    template <int N> static I shl(I a) { return a << N; }
+    template <int N> static I shr(I a) { return a >> N; }
+    static I eqi(I a, I b) { return a == b ? 0xffffffffu : 0; }
+    static I gt(F a, F b) { return a > b ? 0xffffffffu : 0; }
+
+    static F asFloat(I a) { F f; memcpy(&f, &a, sizeof(f)); return f; }
+    static I asInt(F a) { I i; memcpy(&i, &a, sizeof(i)); return i; }
+    static F select(I mask, F a, F b) { return asFloat((mask & asInt(a)) | (~mask & asInt(b))); }
+    static float sum(F a) { return a; }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+struct Avx2Ops {
+    typedef __m256 F;
+    typedef __m256i I;
+    static const int width = 8;
+
+    static F set1(float a) { return _mm256_set1_ps(a); }
+    static F load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, F a) { _mm256_store_ps(p, a); }
+    static I set1i(uint32_t a) { return _mm256_set1_epi32(a); }
+    static I loadi(const uint32_t* p) { return _mm256_load_si256((const __m256i*)p); }
+    static void storei(uint32_t* p, I a) { _mm256_store_si256((__m256i*)p, a); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F fma(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static F round(F a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static I toInt(F a) { return _mm256_cvtps_epi32(a); }
+    static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+
+    static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+    static I xori(I a, I b) { return _mm256_xor_si256(a, b); }
+    static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+    template <int N> static I shl(I a) { return _mm256_slli_epi32(a, N); }
+    template <int N> static I shr(I a) { return _mm256_srli_epi32(a, N); }
+    static I eqi(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+    static I gt(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+
+    static F asFloat(I a) { return _mm256_castsi256_ps(a); }
+    static I asInt(F a) { return _mm256_castps_si256(a); }
+    static F select(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+    static float sum(F a) {
+        float v[8] __attribute__((aligned(32)));
+        _mm256_store_ps(v, a);
+        return ((v[0] + v[1]) + (v[2] + v[3])) + ((v[4] + v[5]) + (v[6] + v[7]));
+    }
+};
+typedef Avx2Ops WideOps;
+#elif defined(__SSE2__)
+struct Sse2Ops {
+    typedef __m128 F;
+    typedef __m128i I;
+    static const int width = 4;
+
+    static F set1(float a) { return _mm_set1_ps(a); }
+    static F load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, F a) { _mm_store_ps(p, a); }
+    static I set1i(uint32_t a) { return _mm_set1_epi32(a); }
+    static I loadi(const uint32_t* p) { return _mm_load_si128((const __m128i*)p); }
+    static void storei(uint32_t* p, I a) { _mm_store_si128((__m128i*)p, a); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F fma(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+    // cvtps rounds to nearest, exact for the magnitudes used here
+    static F round(F a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+    static I toInt(F a) { return _mm_cvtps_epi32(a); }
+    static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+
+    static I andi(I a, I b) { return _mm_and_si128(a, b); }
+    static I xori(I a, I b) { return _mm_xor_si128(a, b); }
+    static I ori(I a, I b) { return _mm_or_si128(a, b); }
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+    template <int N> static I shl(I a) { return _mm_slli_epi32(a, N); }
+    template <int N> static I shr(I a) { return _mm_srli_epi32(a, N); }
+    static I eqi(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+    static I gt(F a, F b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+
+    static F asFloat(I a) { return _mm_castsi128_ps(a); }
+    static I asInt(F a) { return _mm_castps_si128(a); }
+    static F select(I mask, F a, F b) {
+        F m = _mm_castsi128_ps(mask);
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+    static float sum(F a) {
+        float v[4] __attribute__((aligned(16)));
+        _mm_store_ps(v, a);
+        return (v[0] + v[1]) + (v[2] + v[3]);
+    }
+};
+typedef Sse2Ops WideOps;
+#else
+typedef ScalarOps WideOps;
+#endif
+
+// sin and cos of x, |x| up to a few hundred: reduced to r in [-pi/4, pi/4] and
+// the quadrant q, minimax polynomials of r (Cephes sinf/cosf), swapped and
+// negated by q.
+template <class S>
+static void sincos(typename S::F x, typename S::F& sinX, typename S::F& cosX) {
+    typedef typename S::F F;
+    typedef typename S::I I;
+    F j = S::round(S::mul(x, S::set1(2.0f/M_PI)));
+    I q = S::toInt(j);
+    // pi/2 in three parts, so that j*part is exact
+    F r = S::fma(j, S::set1(-1.5703125f), x);
+    r = S::fma(j, S::set1(-4.837512969970703125e-4f), r);
+    r = S::fma(j, S::set1(-7.54978995489188216e-8f), r);
+    F z = S::mul(r, r);
+
+    F s = S::fma(z, S::set1(-1.9515295891e-4f), S::set1(8.3321608736e-3f));
+    s = S::fma(s, z, S::set1(-1.6666654611e-1f));
+    s = S::fma(S::mul(s, z), r, r);
+    F c = S::fma(z, S::set1(2.443315711809948e-5f), S::set1(-1.388731625493765e-3f));
+    c = S::fma(c, z, S::set1(4.166664568298827e-2f));
+    c = S::fma(S::mul(c, z), z, S::fma(z, S::set1(-0.5f), S::set1(1.0f)));
+
+    I one = S::set1i(1);
+    I two = S::set1i(2);
+    I swap = S::eqi(S::andi(q, one), one);
+    I sinSign = S::template shl<30>(S::andi(q, two));
+    I cosSign = S::template shl<30>(S::andi(S::addi(q, one), two));
+    sinX = S::asFloat(S::xori(S::asInt(S::select(swap, c, s)), sinSign));
+    cosX = S::asFloat(S::xori(S::asInt(S::select(swap, s, c)), cosSign));
+}
+
+// natural logarithm of x > 0: the exponent and the mantissa in [sqrt(1/2), sqrt(2)],
+// a polynomial of the mantissa (Cephes logf)
+template <class S>
+static typename S::F logPositive(typename S::F x) {
+    typedef typename S::F F;
+    typedef typename S::I I;
+    I bits = S::asInt(x);
+    I e = S::subi(S::template shr<23>(bits), S::set1i(127));
+    F m = S::asFloat(S::ori(S::andi(bits, S::set1i(0x007fffff)), S::set1i(0x3f800000)));
+    I big = S::gt(m, S::set1(1.41421356f));
+    m = S::select(big, S::mul(m, S::set1(0.5f)), m);
+    e = S::addi(e, S::andi(big, S::set1i(1)));
+    F fe = S::toFloat(e);
+
+    F t = S::sub(m, S::set1(1.0f));
+    F z = S::mul(t, t);
+    F p = S::set1(7.0376836292e-2f);
+    p = S::fma(p, t, S::set1(-1.1514610310e-1f));
+    p = S::fma(p, t, S::set1(1.1676998740e-1f));
+    p = S::fma(p, t, S::set1(-1.2420140846e-1f));
+    p = S::fma(p, t, S::set1(1.4249322787e-1f));
+    p = S::fma(p, t, S::set1(-1.6668057665e-1f));
+    p = S::fma(p, t, S::set1(2.0000714765e-1f));
+    p = S::fma(p, t, S::set1(-2.4999993993e-1f));
+    p = S::fma(p, t, S::set1(3.3333331174e-1f));
+    F y = S::mul(S::mul(p, t), z);
+    y = S::fma(fe, S::set1(-2.12194440e-4f), y);
+    y = S::fma(z, S::set1(-0.5f), y);
+    return S::fma(fe, S::set1(0.693359375f), S::add(t, y));
+}
+
+// xorshift128 in every lane, the four words in registers while a kernel runs
+template <class S>
+struct Random {
+    typedef typename S::F F;
+    typedef typename S::I I;
+    I a, b, c, d;
+
+    explicit Random(const uint32_t* state):
+        a(S::loadi(state)), b(S::loadi(state + lanes)), c(S::loadi(state + 2*lanes)), d(S::loadi(state + 3*lanes)) {}
+    void save(uint32_t* state) const {
+        S::storei(state, a);
+        S::storei(state + lanes, b);
+        S::storei(state + 2*lanes, c);
+        S::storei(state + 3*lanes, d);
+    }
+    I next() {
+        I t = S::xori(a, S::template shl<11>(a));
+        a = b;
+        b = c;
+        c = d;
+        d = S::xori(S::xori(d, S::template shr<19>(d)), S::xori(t, S::template shr<8>(t)));
+        return d;
+    }
+    // uniform in [0, 1) from the upper 23 bits
+    F uniform() {
+        I bits = S::ori(S::template shr<9>(next()), S::set1i(0x3f800000));
+        return S::sub(S::asFloat(bits), S::set1(1.0f));
+    }
+    // two independent standard normals (Box-Muller)
+    void normals(F& first, F& second) {
+        F u1 = S::sub(S::set1(1.0f), uniform());
+        F u2 = uniform();
+        F r = S::sqrt(S::mul(S::set1(-2.0f), logPositive<S>(u1)));
+        F s, c;
+        sincos<S>(S::mul(u2, S::set1(2*M_PI)), s, c);
+        first = S::mul(r, c);
+        second = S::mul(r, s);
+    }
+};
+
+template <class S>
+static typename S::F wrap(typename S::F a) {
+    typedef typename S::F F;
+    F turns = S::round(S::mul(a, S::set1(0.5/M_PI)));
+    return S::fma(turns, S::set1(-2*M_PI), a);
+}
+
+template <class S>
+static void moveKernel(float* x, float* y, float* theta, size_t n, uint32_t* state,
+                       float distance, float turn, float sigmaDistance, float sigmaTurn) {
+    typedef typename S::F F;
+    Random<S> random(state);
+    for (size_t i = 0; i < n; i += S::width) {
+        F noiseDistance, noiseTurn;
+        random.normals(noiseDistance, noiseTurn);
+        F d = S::fma(noiseDistance, S::set1(sigmaDistance), S::set1(distance));
+        F t = S::load(theta + i);
+        F s, c;
+        sincos<S>(t, s, c);
+        S::store(x + i, S::fma(d, c, S::load(x + i)));
+        S::store(y + i, S::fma(d, s, S::load(y + i)));
+        t = S::add(t, S::fma(noiseTurn, S::set1(sigmaTurn), S::set1(turn)));
+        S::store(theta + i, wrap<S>(t));
+    }
+    random.save(state);
+}
+
+template <class S>
+static void jitterKernel(float* x, float* y, float* theta, size_t n, uint32_t* state, float sigma) {
+    typedef typename S::F F;
+    Random<S> random(state);
+    F scale = S::set1(sigma);
+    for (size_t i = 0; i < n; i += S::width) {
+        F nx, ny, nt, unused;
+        random.normals(nx, ny);
+        random.normals(nt, unused);
+        S::store(x + i, S::fma(nx, scale, S::load(x + i)));
+        S::store(y + i, S::fma(ny, scale, S::load(y + i)));
+        S::store(theta + i, S::fma(nt, scale, S::load(theta + i)));
+    }
+    random.save(state);
+}
+
+template <class S>
+static void wrapKernel(float* theta, size_t n) {
+    for (size_t i = 0; i < n; i += S::width) {
+        S::store(theta + i, wrap<S>(S::load(theta + i)));
+    }
+}
+
+template <class S>
+static float sumKernel(const float* values, size_t n) {
+    typename S::F total = S::set1(0);
+    for (size_t i = 0; i < n; i += S::width) {
+        total = S::add(total, S::load(values + i));
+    }
+    return S::sum(total);
+}
+
+template <class S>
+static void scaleKernel(float* values, size_t n, float factor) {
+    typename S::F f = S::set1(factor);
+    for (size_t i = 0; i < n; i += S::width) {
+        S::store(values + i, S::mul(S::load(values + i), f));
+    }
+}
+
+// sums of x, y, sin theta and cos theta over [first, last), a multiple of the width
+template <class S>
+static void estimateKernel(const float* x, const float* y, const float* theta, size_t first, size_t last, float sums[4]) {
+    typedef typename S::F F;
+    F sx = S::set1(0), sy = S::set1(0), ss = S::set1(0), sc = S::set1(0);
+    for (size_t i = first; i < last; i += S::width) {
+        F s, c;
+        sincos<S>(S::load(theta + i), s, c);
+        sx = S::add(sx, S::load(x + i));
+        sy = S::add(sy, S::load(y + i));
+        ss = S::add(ss, s);
+        sc = S::add(sc, c);
+    }
+    sums[0] += S::sum(sx);
+    sums[1] += S::sum(sy);
+    sums[2] += S::sum(ss);
+    sums[3] += S::sum(sc);
+}
+
+void ParticleSet::resize(size_t n) {
+    count = n;
+    size_t padded = (n + lanes - 1)/lanes*lanes;
+    x.resize(padded);
+    y.resize(padded);
+    theta.resize(padded);
+    weight.resize(padded);
+    for (size_t i = n; i < padded; i++) {
+        x[i] = 0;
+        y[i] = 0;
+        theta[i] = 0;
+        weight[i] = 0;
+    }
+}
+
+Particle ParticleSet::get(size_t i) const {
+    Particle p;
+    p.xPos = x[i];
+    p.yPos = y[i];
+    p.thetaPos = theta[i];
+    p.weight = weight[i];
+    return p;
+}
+
+void ParticleSet::set(size_t i, const Particle& p) {
+    x[i] = p.xPos;
+    y[i] = p.yPos;
+    theta[i] = p.thetaPos;
+    weight[i] = p.weight;
+}
+
+void ParticleSet::seed(uint64_t value) {
+    // splitmix64 spreads the seed over the lanes, no lane may start at zero
+    rng.assign(4*lanes, 0);
+    for (size_t k = 0; k < rng.size(); k++) {
+        value += 0x9e3779b97f4a7c15ull;
+        uint64_t z = value;
+        z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+        z = z ^ (z >> 31);
+        rng[k] = (uint32_t)z | 1;
+    }
+}
+
+void ParticleSet::setWeights(float w) {
+    fill(weight.begin(), weight.begin() + count, w);
+}
+
+void ParticleSet::move(float distance, float turn, float sigmaDistance, float sigmaTurn) {
+    moveKernel<WideOps>(x.data(), y.data(), theta.data(), x.size(), rng.data(),
+                        distance, turn, sigmaDistance, sigmaTurn);
+}
+
+void ParticleSet::jitter(float sigma) {
+    jitterKernel<WideOps>(x.data(), y.data(), theta.data(), x.size(), rng.data(), sigma);
+}
+
+void ParticleSet::wrapAngles() {
+    wrapKernel<WideOps>(theta.data(), theta.size());
+}
+
+float ParticleSet::normalise() {
+    float total = sumKernel<WideOps>(weight.data(), weight.size());
+    if (total > 0) {
+        scaleKernel<WideOps>(weight.data(), weight.size(), 1.0f/total);
+    } else {
+        // no particle fits the scan, none is preferred
+        setWeights(count > 0 ? 1.0f/count : 0);
+    }
+    return total;
+}
+
+Particle ParticleSet::estimate(size_t n) const {
+    n = min(n, count);
+    Particle p;
+    if (n == 0) {
+        return p;
+    }
+    float sums[4] = {0, 0, 0, 0};
+    size_t blocks = n/WideOps::width*WideOps::width;
+    estimateKernel<WideOps>(x.data(), y.data(), theta.data(), 0, blocks, sums);
+    estimateKernel<ScalarOps>(x.data(), y.data(), theta.data(), blocks, n, sums);
+    p.xPos = sums[0]/n;
+    p.yPos = sums[1]/n;
+    p.thetaPos = atan2(sums[2], sums[3]);
+    return p;
+}
+
+void ParticleSet::resample(const vector<int>& picks) {
+    size_t n = picks.size();
+    size_t padded = (n + lanes - 1)/lanes*lanes;
+    AlignedFloats* fields[4] = {&x, &y, &theta, &weight};
+    for (int f = 0; f < 4; f++) {
+        AlignedFloats& field = *fields[f];
+        scratch.assign(padded, 0);
+        for (size_t i = 0; i < n; i++) {
+            scratch[i] = field[picks[i]];
+        }
+        field.swap(scratch);
+    }
+    count = n;
+}
+
+const char* ParticleSet::simdName() {
+    switch (WideOps::width) {
+        case 8: return "avx2";
+        case 4: return "sse2";
+        default: return "scalar";
+    }
+}
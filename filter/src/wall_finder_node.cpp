@@ -28,6 +28,8 @@
 
 #include <localization_global_map.h>
 #include <measurements.h>
+#include <wall_finder_node.h>
+#include <scan_preprocessor.h>
 /**
  * This tutorial demonstrates simple sending of messages over the ROS system.
  */
@@ -51,7 +53,7 @@ class WallFinder
     ros::Subscriber stuck_position_subscriber;
 
 
-    std::vector<float> ranges;
+    std::shared_ptr<const PreprocessedScan> scan;
     float angle_increment;
     float range_min;
     float range_max;
@@ -96,9 +98,9 @@ class WallFinder
 
 
 
-    WallFinder(LocalizationGlobalMap newMap)
+    WallFinder(ros::NodeHandle& nh, LocalizationGlobalMap newMap)
     {
-        n = ros::NodeHandle("~");
+        n = nh;
         int nr_measurements = 8;
         _xPos = 0;
         _yPos = 0;
@@ -248,7 +250,7 @@ class WallFinder
 
     void lidarCallback(const sensor_msgs::LaserScan::ConstPtr &msg)
     {
-        ranges = msg->ranges;
+        scan = ScanPreprocessor::preprocess(msg);
         angle_increment = msg->angle_increment;
 
         range_min = msg->range_min;
@@ -298,39 +300,12 @@ class WallFinder
 
     vector<pair<float, float>> mapMeasurementsToAngles()
     {
-        //Sample the measurements
-        int step_size = (ranges.size() / _nr_measurements);
-        std::vector<pair<float, float>> sampled_measurements;
-        float start_angle = -M_PI/2;
-        float range;
-        float angle = 0;
-
-        int i = 0;
-
-        while (i < ranges.size())
+        //Sample the measurements, the scan is shared with the filter
+        if (!scan)
         {
-            angle = (i * angle_increment) + start_angle;
-            range = ranges[i];
-
-            int j = 1;
-            while(std::isinf(range)) {
-                range = ranges[i + j];
-                angle += angle_increment;
-                j++;
-            }
-            i = i +j;
-            
-            if (range > MAX_DISTANCE_LIDAR)
-            {
-                range = MAX_DISTANCE_LIDAR;
-            }
-
-            
-            std::pair<float, float> angle_measurement(angle, range);
-            sampled_measurements.push_back(angle_measurement);
-            i = i + step_size;
+            return vector<pair<float, float>>();
         }
-        return sampled_measurements;
+        return scan->sampleMeasurements(_nr_measurements, MAX_DISTANCE_LIDAR);
     }
 
 
@@ -838,7 +813,7 @@ class WallFinder
 
 };
 
-int main(int argc, char **argv)
+void runWallFinderNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running)
 {
 
     ROS_INFO("Spin!");
@@ -850,11 +825,9 @@ int main(int argc, char **argv)
     std::string _filename_map = homePath+"/catkin_ws/src/automated_travel_entity/filter/maps/lab_maze_2017.txt";
     float cellSize = 0.01;
 
-    ros::init(argc, argv, "wall_finder_publisher");
-
     LocalizationGlobalMap map1(_filename_map, cellSize);
     
-    WallFinder wf(map1);
+    WallFinder wf(n, map1);
 
     wf.addKnownWalls();
 
@@ -869,7 +842,7 @@ int main(int argc, char **argv)
 
     int count = 0;
     int unStuckCommands = 20;
-    while (wf.n.ok())
+    while (wf.n.ok() && running)
     {
     	if(wf._stuck){
     		if(unStuckCommands == 20){
@@ -888,11 +861,9 @@ int main(int argc, char **argv)
             wf.lookForWalls();
 
         }
-        ros::spinOnce();
+        queue.callAvailable();
 
         loop_rate.sleep();
         ++count;
     }
-
-    return 0;
 }
@@ -416,7 +416,12 @@ class Mother:
         request.startPose.linear.y = start_y
         request.goalPose.linear.x = goal_x
         request.goalPose.linear.y = goal_y
-        response = call_srv(self.navigation_distance_service,request)
+        try:
+            response = call_srv(self.navigation_distance_service,request)
+        except ServiceException as se:
+            # the planner did not serve the request, the object goes last
+            rospy.logwarn(se)
+            return float("inf")
         return response.distance
 
     def _handle_object_candidate_msg(self, obj_cand_msg):
@@ -13,9 +13,19 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ros/ros.h>
 #include <std_msgs/Bool.h>
 #include "std_msgs/Float32MultiArray.h"
 
+#include <grid_map.h>
+#include <skeleton_roadmap.h>
+#include <path_smoother.h>
+#include <search_stats.h>
+#include <planner_diagnostics.h>
+
 
 using namespace std;
 
@@ -32,6 +42,16 @@ bool operator<(const Node &a, const Node &b);
 
 bool operator==(const Node &a, const Node &b);
 
+// The exploration state of GlobalPathPlanner, as a copy to plan on.
+struct ExplorationPlan {
+    int status;
+    vector<Node> nodes;
+    vector<pair<double, double> > path;
+    size_t progress;
+    vector<pair<int, int> > nodeMarks;
+    bool mapChanged; // the plan took the map change, discardExploration gives it back
+};
+
 class GlobalPathPlanner
 {
 public:
@@ -40,12 +60,13 @@ public:
     void updateMap();
     vector<pair<double,double> > getPath(pair<double,double> startCoord, pair<double,double> goalCoord);
 
-    vector<vector<unsigned char> > map;
+    // planners pin a snapshot of the map, wall updates publish new versions
+    VersionedMap map;
     pair<double,double> mapOffset;
     pair<double,double> mapScale;
     pair<size_t,size_t> gridSize;
     float cellSize;
-    bool mapChanged;
+    atomic<bool> mapChanged;
 
     pair<int, int> getCell(double x, double y);
     int getDistance(pair<double,double> startCoord, pair<double,double> goalCoord);
@@ -53,37 +74,72 @@ public:
     // exploration
     int explorationStatus; // 0 - initial; 1 - follow path; 2 - do not follow a path; 3 - finished
     vector<Node> nodes;
+    // the path is not changed while it is followed, the follower reports its progress
     vector<pair<double, double> > explorationPath;
-    vector<pair<int, int> > nodeMarks;
+    size_t explorationProgress; // index of the exploration path point the robot passed last
+    vector<pair<int, int> > nodeMarks; // node, index of its point on the exploration path
     void explorationCallback(bool start_exploration, double x, double y);
-    void explorationUpdate(double x, double y, double theta, int pathSize);
+    // explorationCallback in three steps: only taking the state and putting it back
+    // touch the members, planning in between works on pinned maps and can run
+    // without the lock that guards the exploration state
+    ExplorationPlan explorationSnapshot() const;
+    void planExploration(ExplorationPlan& plan, bool start_exploration, double x, double y);
+    void applyExploration(const ExplorationPlan& plan);
+    // a plan that is not applied, the map change it took is kept for the next plan
+    void discardExploration(const ExplorationPlan& plan);
+    void explorationUpdate(double x, double y, double theta, size_t cursor);
 
     // wall adding
     void updateMap(vector<double> wall);
     void newWallCallback(const std_msgs::Float32MultiArray::ConstPtr& array);
-    void addRobotRadiusToPoint(pair<int, int> xy);
+    void addRobotRadiusToPoint(GridMap& grid, pair<int, int> xy);
+
+    // skeleton roadmap, paths longer than roadmapMinLength (m) follow the skeleton
+    // with the maximum clearance, start and goal connect to it within roadmapConnect (m)
+    bool useRoadmap;
+    double roadmapMinLength;
+    double roadmapConnect;
+    shared_ptr<const SkeletonRoadmap> getRoadmap() const { return atomic_load(&roadmap); };
+
+    // paths for the follower are reduced to a few free segments,
+    // smoother parameters are in cells
+    bool smoothPaths;
+    PathSmoother smoother;
+    vector<pair<double,double> > simplifyPath(const vector<pair<double,double> >& path);
+
+    // per query metrics, not recorded if null
+    shared_ptr<PlannerDiagnostics> diagnostics;
+
+    // route ordering
+    vector<int> floodDistances(const GridMap& grid, pair<int,int> source, const vector<pair<int,int> >& targets);
+    vector<int> getRoute(pair<double,double> startCoord, const vector<pair<double,double> >& targets,
+                         double timeBudget, vector<pair<double,double> >& path);
 
     //recovery
-    void writeNodesToFile();
+    void writeNodesToFile(const vector<Node>& nodes);
     void readNodesFromFile();
     void recovery();
     ros::Publisher explorationStatusPub;
 
 private:
     float robotRad;
+    shared_ptr<const SkeletonRoadmap> roadmap;
+    // serializes the map and the roadmap updates
+    mutex roadmapMutex;
     //smoothObstaclesRad;
     //cellValueResolution = 1;
 
-    void addRobotRadiusToObstacles(double r);
+    void addRobotRadiusToObstacles(GridMap& grid, double r);
     void setMap(string mapFile);
     //getLocation(i,j);
     double distanceHeuristic(const Node &a, const Node &b);
-    vector<pair<int,int> > getPathGrid(pair<int,int> startCoord, pair<int, int> goalCoord);
-    double findClosestFreeCell(Node& goal,int maxD);
-    void sampleNodesToExplore();
-    void computeExplorationPath();
-    void getExplorationPath(double x, double y);
-    void recalculateExplorationPath(double x, double y);
+    vector<pair<int,int> > getPathGrid(const GridMap& grid, pair<int,int> startCoord, pair<int, int> goalCoord);
+    double findClosestFreeCell(const GridMap& grid, Node& goal,int maxD);
+    bool snapToFreeCell(const GridMap& grid, pair<int,int>& cell);
+    void sampleNodesToExplore(vector<Node>& nodes);
+    void computeExplorationPath(ExplorationPlan& plan);
+    void getExplorationPath(ExplorationPlan& plan, double x, double y);
+    void recalculateExplorationPath(ExplorationPlan& plan, double x, double y);
 };
 
 #endif // GLOBAL_PATH_PLANNER_H
@@ -0,0 +1,152 @@
+#ifndef GRID_MAP_H
+#define GRID_MAP_H 1
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+// Grid stored in square tiles of TILE_SIZE x TILE_SIZE cells.
+// A tile with all cells equal is not allocated, only its value is kept,
+// so memory grows with the number of tiles containing walls, not with the arena.
+// Copies of a grid share their tiles, a tile is copied on the first write
+// to it (copy-on-write), so copying a grid costs one pointer per tile.
+template <typename T>
+class TiledGrid {
+public:
+    static const int TILE_BITS = 6;
+    static const int TILE_SIZE = 1 << TILE_BITS;
+    static const int TILE_MASK = TILE_SIZE - 1;
+
+    size_t nx;
+    size_t ny;
+    size_t version;
+
+    TiledGrid(): nx(0), ny(0), version(0), tilesX(0), tilesY(0) {};
+    TiledGrid(size_t p_nx, size_t p_ny, T value): nx(p_nx), ny(p_ny), version(0) {
+        tilesX = (nx + TILE_SIZE - 1) >> TILE_BITS;
+        tilesY = (ny + TILE_SIZE - 1) >> TILE_BITS;
+        tiles = vector<shared_ptr<Tile> >(tilesX*tilesY);
+        uniform = vector<T>(tilesX*tilesY, value);
+    };
+
+    T get(int i, int j) const {
+        size_t k = (i >> TILE_BITS)*tilesY + (j >> TILE_BITS);
+        const Tile* tile = tiles[k].get();
+        if (tile == 0) {
+            return uniform[k];
+        }
+        return (*tile)[((i & TILE_MASK) << TILE_BITS) | (j & TILE_MASK)];
+    };
+
+    void set(int i, int j, T value) {
+        size_t k = (i >> TILE_BITS)*tilesY + (j >> TILE_BITS);
+        shared_ptr<Tile>& tile = tiles[k];
+        if (!tile) {
+            if (uniform[k] == value) {
+                return;
+            }
+            tile = make_shared<Tile>(TILE_SIZE*TILE_SIZE, uniform[k]);
+            dirty.push_back(k);
+        } else if (tile.use_count() > 1) {
+            // shared with another version of the grid
+            tile = make_shared<Tile>(*tile);
+            dirty.push_back(k);
+        }
+        (*tile)[((i & TILE_MASK) << TILE_BITS) | (j & TILE_MASK)] = value;
+    };
+
+    // releases the tiles written since the last call which became uniform
+    void compress() {
+        for (size_t d = 0; d < dirty.size(); d++) {
+            size_t k = dirty[d];
+            if (!tiles[k]) {
+                continue;
+            }
+            const Tile& tile = *tiles[k];
+            size_t c = 1;
+            while (c < tile.size() && tile[c] == tile[0]) {
+                c++;
+            }
+            if (c == tile.size()) {
+                uniform[k] = tile[0];
+                tiles[k].reset();
+            }
+        }
+        dirty.clear();
+    };
+
+    // true if the tile (ti, tj) is not allocated, value is then the value of all its cells
+    bool uniformTile(size_t ti, size_t tj, T& value) const {
+        size_t k = ti*tilesY + tj;
+        value = uniform[k];
+        return !tiles[k];
+    };
+
+    size_t tileCountX() const { return tilesX; };
+    size_t tileCountY() const { return tilesY; };
+
+    size_t allocatedTiles() const {
+        size_t count = 0;
+        for (size_t k = 0; k < tiles.size(); k++) {
+            if (tiles[k]) {
+                count++;
+            }
+        }
+        return count;
+    };
+
+    size_t memoryUsage() const {
+        return allocatedTiles()*TILE_SIZE*TILE_SIZE*sizeof(T) +
+               tiles.size()*(sizeof(shared_ptr<Tile>) + sizeof(T));
+    };
+
+private:
+    typedef vector<T> Tile;
+    size_t tilesX;
+    size_t tilesY;
+    vector<shared_ptr<Tile> > tiles;
+    vector<T> uniform;
+    vector<size_t> dirty;
+};
+
+typedef TiledGrid<unsigned char> GridMap;
+
+// Holds the latest published version of the map.
+// Readers pin a version for the whole query and never block the writer,
+// a version is freed when the last reader releases it.
+// Writers modify a copy of the latest version and publish it as a new one.
+class VersionedMap {
+public:
+    VersionedMap(): current(make_shared<GridMap>()) {};
+
+    shared_ptr<const GridMap> pin() const {
+        return atomic_load(&current);
+    };
+
+    // f(GridMap&) modifies a copy of the latest version which then gets published
+    template <typename F>
+    size_t update(F f) {
+        lock_guard<mutex> lock(writeMutex);
+        GridMap next(*atomic_load(&current));
+        f(next);
+        next.compress();
+        next.version++;
+        size_t version = next.version;
+        atomic_store(&current, shared_ptr<const GridMap>(make_shared<GridMap>(std::move(next))));
+        return version;
+    };
+
+    void reset(GridMap grid) {
+        lock_guard<mutex> lock(writeMutex);
+        grid.compress();
+        atomic_store(&current, shared_ptr<const GridMap>(make_shared<GridMap>(std::move(grid))));
+    };
+
+private:
+    shared_ptr<const GridMap> current;
+    mutex writeMutex;
+};
+
+#endif // GRID_MAP_H
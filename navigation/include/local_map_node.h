@@ -0,0 +1,12 @@
+#ifndef LOCAL_MAP_NODE_H
+#define LOCAL_MAP_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Serves the local_path service from the lidar local map until ROS shuts down
+// or running is cleared, queue is the callback queue of nh.
+void runLocalMapNode(ros::NodeHandle& nh, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // LOCAL_MAP_NODE_H
@@ -0,0 +1,234 @@
+/*
+ *  local_path_planner.h
+ *
+ *
+ *  Created on: Nov 1, 2017
+ *  Authors:   Jevgenija Aksjonova
+ *            jevaks <at> kth.se
+ */
+
+#ifndef LOCAL_PATH_PLANNER_H
+#define LOCAL_PATH_PLANNER_H 1
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "project_msgs/direction.h"
+#include "project_msgs/directions.h"
+#include "project_msgs/depth.h"
+#include <nav_msgs/Odometry.h>
+#include <geometry_msgs/Twist.h>
+
+#include <scan_preprocessor.h>
+#include <polar_bins.h>
+#include <obstacle_ring.h>
+#include <rolling_grid.h>
+#include <safety_zone.h>
+
+using namespace std;
+
+// Obstacle points around the robot, base_link, of one local map update.
+struct ObstaclePoints {
+    vector<float> x;
+    vector<float> y;
+};
+
+// Polar map (Bins bins over the circle) of the obstacles around the robot,
+// compiled for 360, 720 and 1440 bins (local_path_planner.cpp).
+// The sensor callbacks build a new map and publish it as an immutable snapshot,
+// amendDirection() reads the latest snapshot, so it can be called from another
+// thread (the control loop of navigation_node) without waiting for the callbacks.
+// The sensor callbacks have to be called from a single thread.
+template <int Bins>
+class PolarLocalPathPlanner {
+  public:
+    ros::Publisher lppViz;
+    ros::Publisher stopPub;
+
+    PolarLocalPathPlanner(double p_robotRad, double p_mapRad):
+                                    robotRad(p_robotRad),
+                                    mapRad(p_mapRad),
+                                    occupied(Bins,0),
+                                    filtered(Bins,0),
+                                    distance(Bins,0),
+                                    distanceDepth(Bins,0),
+                                    useDepth(true),
+                                    depthLifetime(4.0),
+                                    depthObstacles(1024),
+                                    rangesDepth(1024,0),
+                                    anglesDepth(1024,0),
+                                    locX(0),
+                                    locY(0),
+                                    locTheta(0),
+                                    binMaxWidth(Bins,-1),
+                                    binMinWidth(Bins,0),
+                                    bestReach(Bins,0),
+                                    bestRamp(Bins,1),
+                                    candidateReach(Bins + Bins/4,0),
+                                    candidateRamp(Bins + Bins/4,0),
+                                    runLeft(Bins,0),
+                                    runRight(Bins,0),
+                                    blockedLeft(Bins,0),
+                                    blockedRight(Bins,0),
+                                    commandLin(0),
+                                    commandAng(0),
+                                    safetyZone(p_robotRad){
+        buildWidthTable(robotRad, maxWidth);
+        buildWidthTable(robotRad-0.05, minWidth);
+    };
+
+    void lidarCallback(const sensor_msgs::LaserScan::ConstPtr& msg);
+    void depthCallback(const project_msgs::depth::ConstPtr& msg);
+    void locationCallback(const nav_msgs::Odometry::ConstPtr& msg);
+    // the command sent to the motors, sizes the lidar stop zone
+    void twistCallback(const geometry_msgs::Twist::ConstPtr& msg);
+    // closest free direction to angVel (rad, robot frame), linVel sets the map radius
+    double amendDirection(double linVel, double angVel);
+    // the same for several headings, all answered from the same map
+    vector<double> amendDirections(double linVel, const vector<double>& angVels);
+    // local_path and local_path_batch services
+    bool directionCallback(project_msgs::direction::Request  &req,
+                           project_msgs::direction::Response &res);
+    bool directionsCallback(project_msgs::directions::Request  &req,
+                            project_msgs::directions::Response &res);
+    void showLocalMap();
+    // the obstacle points the latest map was built from, within pointRange;
+    // they stay valid as long as the pointer is held
+    shared_ptr<const ObstaclePoints> obstaclePoints();
+    // builds the map from a rolling grid around the robot (side, cell size in m) instead of
+    // the latest scan and the depth ring, so it remembers what the sensors no longer see
+    void useRollingGrid(double side = 1.5, double cellSize = 0.02);
+  private:
+    typedef PolarBins<Bins> Polar;
+
+    // What amendDirection answers for a heading in a bin, worked out for every bin
+    // once per map: the bins (offsets from the heading) it would turn to on either
+    // side, the one it picks and the stops it raises.
+    struct Heading {
+        int left;
+        int right;
+        int amended;
+        bool deviation;
+        bool blocked;
+    };
+    struct LocalMap {
+        vector<float> bins;
+        vector<Heading> headings;
+        ObstaclePoints points;
+        LocalMap(): bins(Bins, 0), headings(Bins) {};
+    };
+    // number of bins in a row from each bin, going left and going right, that are above
+    // the threshold (and not below the next one, with uphill), Bins if all of them are
+    void runs(const vector<float>& bins, double above, bool uphill, vector<int>& left, vector<int>& right);
+    vector<int> runLeft;
+    vector<int> runRight;
+    vector<int> blockedLeft;
+    vector<int> blockedRight;
+
+    atomic<double> mapRad;
+    double robotRad;
+
+    // lidar data
+    shared_ptr<const PreprocessedScan> scan;
+    float angleIncrement;
+    float range_min;
+    float range_max;
+
+    // depth data: the hits in odom, kept for depthLifetime seconds,
+    // and their ranges and bearings from the robot at the last map update
+    bool useDepth;
+    double depthLifetime;
+    ObstacleRing depthObstacles;
+    vector<float> rangesDepth;
+    vector<float> anglesDepth;
+
+    // rolling grid, if used, and the cells around the robot's cell in order of distance
+    // (offsets, distance and bearing in odom), to read the polar map off the grid
+    shared_ptr<RollingGrid> grid;
+    vector<int> gridOffsetX;
+    vector<int> gridOffsetY;
+    vector<float> gridOffsetRange;
+    vector<float> gridOffsetAngle;
+    void updateGrid();
+    void mapGrid(double rad);
+
+    //location, odom
+    double locX;
+    double locY;
+    double locTheta;
+
+    // Where a lidar hit lands in the polar map around base_link, per beam of the scan layout:
+    // squared distance r*r + 2*r*beamProjection[i] + offset2, and bin farBin[i] unless
+    // r is below remapThreshold[k] (descending, k from remapFirst[i] to remapFirst[i+1]),
+    // then remapBin[k] of the last such k. Rebuilt when the layout changes.
+    shared_ptr<const BeamTable> remapBeams;
+    vector<float> beamProjection;
+    float offset2;
+    vector<int> farBin;
+    vector<int> remapFirst;
+    vector<float> remapThreshold;
+    vector<int> remapBin;
+    int beamSpan;   // bins per beam
+    void buildRemap(const shared_ptr<const BeamTable>& table);
+
+    // work buffers of updateLocalMapLidar, allocated once
+    vector<float> occupied;
+    vector<float> filtered;
+    vector<float> distance;
+    vector<float> distanceDepth;
+    // the published map and spares: a buffer is written again
+    // only when no amendDirection call holds it any more
+    vector<shared_ptr<LocalMap> > mapBuffers;
+    shared_ptr<const LocalMap> localMapProcessed;
+    void indexHeadings(LocalMap& localMap);
+    static constexpr double pointRange = 1.5;
+    void collectPoints(ObstaclePoints& points);
+    double amendDirection(const LocalMap& localMap, double angVel);
+    void updateLocalMapLidar();
+    void mapLidar(double rad);
+    void filterNoise();
+    void addDepth(double rad);
+    void addRobotRadius(double rad, vector<float>& localMap);
+
+    // half-widths (bins) an obstacle at distance d covers, for the robot radius and 5 cm less:
+    // the width is the number of entries >= d, replaces asin in addRobotRadius
+    vector<double> maxWidth;
+    vector<double> minWidth;
+    void buildWidthTable(double radius, vector<double>& widths);
+    static int width(const vector<double>& widths, double d);
+    // Dilation: an obstacle bin i with half-widths M, N gives bin j the value
+    // min(1, (M+1-|j-i|)/(M+1-N)), a falling line of ramp M+1-N that ends at i+M+1.
+    // Sweeping the map once each way only the lines that no later line covers
+    // (ends sooner with a steeper ramp) are kept as candidates, usually a handful,
+    // and compared exactly as fractions.
+    vector<int> binMaxWidth;
+    vector<int> binMinWidth;
+    vector<int> bestReach;
+    vector<int> bestRamp;
+    vector<int> candidateReach;
+    vector<int> candidateRamp;
+    void sweepRobotRadius(bool clockwise);
+    // checks addRobotRadius against the stamping loop it replaced (test/test_robot_radius.cpp)
+    friend struct RobotRadiusTest;
+
+    // lidar stop: beams 60 to 120 under 0.215 m, and what the robot
+    // covers until it stops from the last command
+    double commandLin;
+    double commandAng;
+    SafetyZone safetyZone;
+    void stop(int reason);
+    void emergencyStopLidar();
+};
+
+// the bin count the nodes are built with, set with -DLOCAL_MAP_BINS=720 (CMake option)
+#ifndef LOCAL_MAP_BINS
+#define LOCAL_MAP_BINS 360
+#endif
+static_assert(LOCAL_MAP_BINS == 360 || LOCAL_MAP_BINS == 720 || LOCAL_MAP_BINS == 1440,
+              "the local map is compiled for 360, 720 or 1440 bins");
+typedef PolarLocalPathPlanner<LOCAL_MAP_BINS> LocalPathPlanner;
+
+#endif // LOCAL_PATH_PLANNER_H
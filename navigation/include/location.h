@@ -1,21 +1,35 @@
 #ifndef LOCATION_H
 #define LOCATION_H 1
 
+#include <memory>
+#include <atomic>
+
 #include <ros/ros.h>
 #include <nav_msgs/Odometry.h>
 
 using namespace std;
 
+struct Pose {
+    double x;
+    double y;
+    double theta;
+};
+
+// The robot pose from /odom. x, y and theta belong to the thread that calls callback()
+// (the control loop), other threads read latest(), a copy handed over without a lock.
 class Location {
   public:
     double x;
     double y;
     double theta;
 
-    Location() {};
+    Location(): pose(make_shared<Pose>()) {};
     Location(double _xStart, double _yStart, double _thetaStart);
     void callback(const nav_msgs::Odometry::ConstPtr& msg);
+    shared_ptr<const Pose> latest() const { return atomic_load(&pose); };
   private:
+    shared_ptr<const Pose> pose;
+    void publish();
     double xStart;
     double yStart;
     double thetaStart;
@@ -31,7 +31,8 @@ class MapVisualization {
     MapVisualization(shared_ptr<GlobalPathPlanner> _gpp);
     void loadMap();
     void publishMap(int count);
-    void publishPath(vector<pair<double, double> >& globalPath);
+    // publishes the path from the point "from" on
+    void publishPath(vector<pair<double, double> >& globalPath, size_t from = 0);
     void publishDirection(double linVel, double angVel);
     void publishNodes();
 
@@ -0,0 +1,13 @@
+#ifndef NAVIGATION_NODE_H
+#define NAVIGATION_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Runs the planners and the path follower until ROS shuts down or running is cleared.
+// queue is the callback queue of n, the control loop serves it on the calling thread,
+// the planner services and the map updates get their own spinners.
+void runNavigationNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // NAVIGATION_NODE_H
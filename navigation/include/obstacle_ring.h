@@ -0,0 +1,36 @@
+#ifndef OBSTACLE_RING_H
+#define OBSTACLE_RING_H 1
+
+#include <vector>
+#include <stddef.h>
+
+using namespace std;
+
+// Obstacle points in a fixed (odom) frame, oldest first, at most capacity of them:
+// when full the oldest point is overwritten. The points are stored once and never
+// moved with the robot, project() gives them as seen from a robot pose.
+class ObstacleRing {
+  public:
+    explicit ObstacleRing(size_t p_capacity);
+
+    void add(float x, float y, double stamp);
+    // drops the points stamped before the given time
+    void expire(double before);
+    size_t size() const { return count; }
+    // range and bearing of every point from (x, y) with heading theta,
+    // written to the first size() entries of ranges and angles
+    void project(double x, double y, double theta, vector<float>& ranges, vector<float>& angles) const;
+
+  private:
+    size_t capacity;
+    size_t first;   // oldest point
+    size_t count;
+    vector<float> xs;
+    vector<float> ys;
+    vector<double> stamps;
+
+    void projectSpan(size_t from, size_t to, size_t out, float x, float y, float c, float s,
+                     vector<float>& ranges, vector<float>& angles) const;
+};
+
+#endif // OBSTACLE_RING_H
@@ -13,8 +13,22 @@
 #include <project_msgs/stop.h>
 #include "project_msgs/direction.h"
 
+#include <waypoint_path.h>
+#include <local_path_planner.h>
+
 using namespace std;
 
+// A path found on a planner thread, for the control loop to take over.
+struct PathOffer {
+    bool found;
+    double x;
+    double y;
+    double theta;
+    double distanceTol;
+    double angleTol;
+    vector<pair<double,double> > points;
+};
+
 class Path {
   public:
     double linVel;
@@ -24,15 +38,20 @@ class Path {
     bool rollback;
     bool onlyTurn;
     double directionChange;
+    // the point followPath steers to (odom): the carrot, or the goal near the end
+    double targetX;
+    double targetY;
 
-    vector<pair<double,double> > globalPath;
+    WaypointPath globalPath;
 
-    ros::ServiceClient lppService;
+    // local map of the obstacles, directions are amended in-process
+    shared_ptr<LocalPathPlanner> lpp;
     ros::Publisher statusPub;
     ros::Publisher stopPub;
 
     Path(double _pathRad, double _distanceTol, double _angleTol): 
         linVel(0), angVel(0), 
+        targetX(0), targetY(0),
         pathRad(_pathRad), 
         distanceTol(_distanceTol), 
         angleTol(_angleTol), 
@@ -44,7 +63,14 @@ class Path {
     void followPath(double x, double y, double theta);
     void obstaclesCallback(const project_msgs::stop::ConstPtr& msg);
     void setPath(double x, double y, double theta, double p_distancetol, double p_angleTol, vector<pair<double,double> > path);
+    // Planner threads offer paths, the control loop takes the latest one at its next
+    // step; without found the robot goes on with the path it has.
+    void offerPath(double x, double y, double theta, double p_distanceTol, double p_angleTol,
+                   const vector<pair<double,double> >& path, bool found = true);
+    // applies the latest offer, false if there was none
+    bool takeOffer();
   private:
+    shared_ptr<const PathOffer> offer;
     double pathRad;
     double distanceTol;
     double angleTol;
@@ -0,0 +1,45 @@
+#ifndef PATH_SMOOTHER_H
+#define PATH_SMOOTHER_H 1
+
+#include <vector>
+#include <math.h>
+
+#include <grid_map.h>
+#include <skeleton_roadmap.h>
+
+using namespace std;
+
+// Turns a path of cells into a short polyline.
+// Every segment it emits is checked to cross free cells of the (inflated) grid only,
+// and if a clearance field is given, cells with at least minClearance to the obstacles,
+// or as much as the segment's ends have where the path itself runs closer.
+//  1. Ramer-Douglas-Peucker decimation with tolerance (cells)
+//  2. line of sight shortcuts between the remaining points
+//  3. corners replaced by arcs of turnRadius (cells), if turnRadius > 0
+// Points are in cells, the centre of cell (i,j) is (i+0.5, j+0.5).
+class PathSmoother {
+public:
+    double tolerance;
+    double minClearance;
+    double turnRadius;
+    double arcStep;     // rad between the arc points
+
+    PathSmoother(): tolerance(2), minClearance(0), turnRadius(0), arcStep(M_PI/6) {};
+
+    vector<pair<double,double> > simplify(const GridMap& grid, const vector<pair<int,int> >& cells,
+                                          const SkeletonRoadmap* clearance = 0) const;
+    // all the cells the segment a-b passes are free
+    bool lineOfSight(const GridMap& grid, pair<double,double> a, pair<double,double> b,
+                     const SkeletonRoadmap* clearance = 0) const;
+
+private:
+    bool isFree(const GridMap& grid, int i, int j, const SkeletonRoadmap* clearance, double margin) const;
+    vector<pair<double,double> > decimate(const GridMap& grid, const vector<pair<double,double> >& points,
+                                          const SkeletonRoadmap* clearance) const;
+    vector<pair<double,double> > shortcut(const GridMap& grid, const vector<pair<double,double> >& points,
+                                          const SkeletonRoadmap* clearance) const;
+    vector<pair<double,double> > roundCorners(const GridMap& grid, const vector<pair<double,double> >& points,
+                                              const SkeletonRoadmap* clearance) const;
+};
+
+#endif // PATH_SMOOTHER_H
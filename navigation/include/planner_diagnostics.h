@@ -0,0 +1,87 @@
+#ifndef PLANNER_DIAGNOSTICS_H
+#define PLANNER_DIAGNOSTICS_H 1
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+
+#include <ros/ros.h>
+
+#include <search_stats.h>
+
+using namespace std;
+
+struct QueryRecord {
+    const char* query;
+    double wallTime;        // ms
+    size_t expansions;
+    size_t heapPeak;
+    size_t pathCells;
+    double snapDistance;    // cells
+    bool roadmapHit;
+    bool found;
+    pair<double,double> start;
+    pair<double,double> goal;
+};
+
+// Aggregates the planner queries into histograms,
+// publish() sends one message per query type and starts a new window.
+// record() only takes a lock and increments a few counters.
+class PlannerDiagnostics {
+public:
+    ros::Publisher pub;
+
+    PlannerDiagnostics();
+    void record(const QueryRecord& query);
+    void publish(const ros::TimerEvent& event);
+
+private:
+    struct Histogram {
+        string metric;
+        vector<double> bounds;  // upper bounds, the last bin is unbounded
+        vector<int> counts;
+        double sum;
+        double max;
+
+        Histogram(const string& p_metric, const vector<double>& p_bounds);
+        void add(double value);
+    };
+    struct QueryStats {
+        int count;
+        int failures;
+        int roadmapHits;
+        vector<Histogram> histograms;
+        QueryRecord slowest;
+    };
+
+    mutex statsMutex;
+    map<string, QueryStats> stats;
+    ros::Time windowStart;
+
+    QueryStats newQueryStats();
+};
+
+// Measures the outermost planner query of the calling thread,
+// queries made by it (getDistance -> getPath) are counted as its part.
+class QueryProbe {
+public:
+    size_t pathCells;
+    bool found;
+
+    QueryProbe(PlannerDiagnostics* p_diagnostics, const char* p_query,
+               pair<double,double> p_start, pair<double,double> p_goal);
+    ~QueryProbe();
+
+private:
+    PlannerDiagnostics* diagnostics;
+    const char* query;
+    pair<double,double> start;
+    pair<double,double> goal;
+    bool outermost;
+    SearchStats saved;
+    chrono::steady_clock::time_point started;
+};
+
+#endif // PLANNER_DIAGNOSTICS_H
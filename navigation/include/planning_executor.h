@@ -0,0 +1,71 @@
+#ifndef PLANNING_EXECUTOR_H
+#define PLANNING_EXECUTOR_H 1
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <chrono>
+
+#include <ros/ros.h>
+
+using namespace std;
+
+// Runs planner requests on a pool of worker threads.
+// Pending requests are served by priority (goal > exploration > distance),
+// a new goal request cancels the goal requests submitted before it.
+class PlanningExecutor {
+public:
+    enum Priority { DISTANCE = 0, EXPLORATION = 1, GOAL = 2 };
+    // the job should check the flag before applying its result
+    typedef function<void(const atomic<bool>& cancelled)> Job;
+
+    // queue depth and latency report, published after every request
+    ros::Publisher statsPub;
+
+    PlanningExecutor(int p_threads, size_t p_maxQueue);
+    ~PlanningExecutor();
+    // blocks until the job is done
+    // returns false if the request was rejected (queue is full) or cancelled
+    bool run(Priority priority, Job job);
+    // queues the job and returns, false if it was rejected
+    bool post(Priority priority, Job job);
+    // cancels the running jobs and waits for them, later requests are rejected
+    void shutdown();
+    size_t queueDepth();
+
+private:
+    struct Request {
+        Priority priority;
+        unsigned long seq;
+        Job job;
+        shared_ptr<atomic<bool> > cancelled;
+        promise<bool> done;
+        chrono::steady_clock::time_point submitted;
+    };
+
+    size_t maxQueue;
+    unsigned long seq;
+    bool stopping;
+    vector<shared_ptr<Request> > queue;
+    vector<shared_ptr<Request> > running;
+    vector<thread> workers;
+    mutex queueMutex;
+    condition_variable queueCondition;
+
+    // statistics
+    size_t completed;
+    size_t rejected;
+    size_t cancelled;
+    double maxLatency;
+
+    future<bool> submit(Priority priority, Job job);
+    void worker();
+    void finish(shared_ptr<Request> request, bool result);
+};
+
+#endif // PLANNING_EXECUTOR_H
@@ -0,0 +1,57 @@
+#ifndef POLAR_BINS_H
+#define POLAR_BINS_H 1
+
+#include <math.h>
+
+// Angular bins of a polar map around the robot, Bins bins over the full circle,
+// bin 0 straight ahead, counter-clockwise. Everything that depends on the bin
+// count only is resolved at compile time: the divisions by Bins become
+// multiplications and a power of two wraps around with a mask.
+template <int Bins>
+struct PolarBins {
+    static_assert(Bins > 0 && Bins % 4 == 0, "the quarter circle has to be a whole number of bins");
+
+    static const int size = Bins;
+    static const int quarter = Bins/4;
+    static const int half = Bins/2;
+    static const bool powerOfTwo = (Bins & (Bins - 1)) == 0;
+
+    static int wrap(int i) {
+        return powerOfTwo ? (i & (Bins - 1)) : ((i % Bins) + Bins) % Bins;
+    }
+    // closest bin of an angle (rad)
+    static int bin(double angle) {
+        return wrap(round(angle/2.0/M_PI*Bins));
+    }
+    static double angle(double bin) {
+        return bin/Bins*2*M_PI;
+    }
+    // bins from degrees, for the widths given in degrees
+    static int fromDegrees(int degrees) {
+        return degrees*Bins/360;
+    }
+
+    // cos and sin of the bin centres and of the borders between bin k and k+1
+    struct Tables {
+        double cosCentre[Bins];
+        double sinCentre[Bins];
+        double cosBorder[Bins];
+        double sinBorder[Bins];
+
+        Tables() {
+            for (int k = 0; k < Bins; k++) {
+                cosCentre[k] = cos(angle(k));
+                sinCentre[k] = sin(angle(k));
+                cosBorder[k] = cos((k + 0.5)/Bins*2*M_PI);
+                sinBorder[k] = sin((k + 0.5)/Bins*2*M_PI);
+            }
+        }
+    };
+    // one instance per bin count, built on first use
+    static const Tables& tables() {
+        static const Tables instance;
+        return instance;
+    }
+};
+
+#endif // POLAR_BINS_H
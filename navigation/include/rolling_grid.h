@@ -0,0 +1,64 @@
+#ifndef ROLLING_GRID_H
+#define ROLLING_GRID_H 1
+
+#include <vector>
+
+using namespace std;
+
+// Occupancy grid of cells x cells square cells around the robot, axis-aligned in odom.
+// The window follows the robot a whole cell at a time, the storage wraps around
+// (cell ix, iy of odom is stored at ix mod cells, iy mod cells), so moving only
+// clears the rows and columns that come in. Each cell has an occupancy in [0, 1]
+// per sensor: a hit raises it, a ray through it lowers it, and it fades with time.
+class RollingGrid {
+  public:
+    enum Layer { LIDAR = 0, DEPTH = 1, LAYERS = 2 };
+
+    RollingGrid(double p_cellSize, int p_cells, double p_halfLife);
+
+    // recentres the window on (x, y)
+    void moveTo(double x, double y);
+    // fades every cell by the time passed since the last call
+    void decay(double now);
+    // the cells from (x0, y0) to (x1, y1) are free, the last one is occupied if hit,
+    // the ray is cut where it leaves the window
+    void castRay(Layer layer, double x0, double y0, double x1, double y1, bool hit);
+
+    double cellSize() const { return size; }
+    // odom cell of the robot, the centre of the window
+    int centreX() const { return centreCellX; }
+    int centreY() const { return centreCellY; }
+    // a cell of odom, by any of the layers; false outside the window
+    bool occupied(int ix, int iy) const {
+        if (!inside(ix, iy)) {
+            return false;
+        }
+        int k = index(ix, iy);
+        return layers[LIDAR][k] > threshold || layers[DEPTH][k] > threshold;
+    }
+
+  private:
+    double size;
+    int cells;
+    double halfLife;
+    float hitGain;
+    float missFactor;
+    float threshold;
+
+    int centreCellX;
+    int centreCellY;
+    double lastDecay;
+    vector<float> layers[LAYERS];
+
+    int wrap(int i) const { return ((i % cells) + cells) % cells; }
+    int index(int ix, int iy) const { return wrap(iy)*cells + wrap(ix); }
+    bool inside(int ix, int iy) const {
+        int lowX = centreCellX - cells/2;
+        int lowY = centreCellY - cells/2;
+        return ix >= lowX && ix < lowX + cells && iy >= lowY && iy < lowY + cells;
+    }
+    void clearColumn(int ix);
+    void clearRow(int iy);
+};
+
+#endif // ROLLING_GRID_H
@@ -0,0 +1,17 @@
+#ifndef ROUTE_ORDERING_H
+#define ROUTE_ORDERING_H 1
+
+#include <vector>
+
+using namespace std;
+
+// Orders the visit of all targets of an open route starting at node 0.
+// dist is a symmetric (n+1)x(n+1) matrix of path lengths, node 0 is the start.
+// Nearest neighbour construction, then 2-opt and or-opt improvements with
+// random restarts until timeBudget (seconds) is spent.
+// Returns the visiting order as indices 1..n of dist.
+vector<int> orderRoute(const vector<vector<int> >& dist, double timeBudget);
+
+int routeLength(const vector<vector<int> >& dist, const vector<int>& tour);
+
+#endif // ROUTE_ORDERING_H
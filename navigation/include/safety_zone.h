@@ -0,0 +1,55 @@
+#ifndef SAFETY_ZONE_H
+#define SAFETY_ZONE_H 1
+
+#include <vector>
+#include <memory>
+
+#include <scan_preprocessor.h>
+
+using namespace std;
+
+// How fast the robot can stop, and the velocities the zone tables are made for.
+struct StoppingLimits {
+    double linDecel;    // m/s^2
+    double angDecel;    // rad/s^2
+    double latency;     // s, from the scan to the motors reacting
+    double maxLin;      // m/s, larger commands use the table of maxLin
+    double maxAng;      // rad/s
+    int linBuckets;     // odd, from -maxLin to maxLin
+    int angBuckets;     // odd, from -maxAng to maxAng
+
+    StoppingLimits(): linDecel(0.5), angDecel(2.0), latency(0.15),
+                      maxLin(0.5), maxAng(2.0), linBuckets(9), angBuckets(9) {};
+};
+
+// The area the robot covers until it stops from the commanded twist, on top of a static zone:
+// discs of the robot radius along the braking trajectory. For each velocity bucket and
+// each beam the ranges that end in the zone are tabulated once per scan layout, a scan is
+// checked against the bucket of the command (rounded away from zero) with two comparisons per beam.
+class SafetyZone {
+  public:
+    SafetyZone(double p_robotRad, const StoppingLimits& p_limits = StoppingLimits()):
+        robotRad(p_robotRad), limits(p_limits) {};
+
+    // robotBeams are the beams in base_link, staticMin/Max the static zone per beam
+    void build(const shared_ptr<const BeamTable>& robotBeams,
+               const vector<float>& staticMin, const vector<float>& staticMax);
+    bool built(const shared_ptr<const BeamTable>& robotBeams) const { return beams == robotBeams; }
+    // number of beams of ranges that end in the zone for the command (linVel, angVel)
+    int violations(const vector<float>& ranges, double linVel, double angVel) const;
+
+  private:
+    double robotRad;
+    StoppingLimits limits;
+    shared_ptr<const BeamTable> beams;
+    // bucket b, beam i at b*beams + i
+    vector<float> insideMin;
+    vector<float> insideMax;
+
+    static double bucketValue(int k, int buckets, double maxValue);
+    static int bucket(double value, int buckets, double maxValue);
+    // centres of the discs that cover the braking trajectory, in base_link
+    void trajectory(double linVel, double angVel, vector<pair<double,double> >& centres) const;
+};
+
+#endif // SAFETY_ZONE_H
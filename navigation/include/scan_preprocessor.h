@@ -0,0 +1,72 @@
+#ifndef SCAN_PREPROCESSOR_H
+#define SCAN_PREPROCESSOR_H 1
+
+#include <vector>
+#include <memory>
+#include <math.h>
+
+#include "sensor_msgs/LaserScan.h"
+
+using namespace std;
+
+// Where the beams of a scan point: beam i has the bearing startAngle + direction*i*angle_increment
+// and starts at (x, y). The default is the lidar on the robot, in base_link.
+struct ScanGeometry {
+    float startAngle;
+    float direction;
+    float x;
+    float y;
+
+    ScanGeometry(float p_startAngle = -M_PI/2, float p_direction = 1, float p_x = -0.03, float p_y = 0):
+        startAngle(p_startAngle), direction(p_direction), x(p_x), y(p_y) {};
+
+    bool operator==(const ScanGeometry& other) const {
+        return startAngle == other.startAngle && direction == other.direction && x == other.x && y == other.y;
+    }
+};
+
+// Bearing, cos and sin of every beam, the same for all the scans of one lidar.
+struct BeamTable {
+    ScanGeometry geometry;
+    size_t size;
+    float angleIncrement;
+    vector<float> angles;
+    vector<float> cosAngles;
+    vector<float> sinAngles;
+
+    BeamTable(const ScanGeometry& p_geometry, size_t p_size, float p_angleIncrement);
+    bool matches(const ScanGeometry& p_geometry, size_t p_size, float p_angleIncrement) const {
+        return geometry == p_geometry && size == p_size && angleIncrement == p_angleIncrement;
+    }
+};
+
+// A scan with the work every consumer would otherwise repeat done once:
+// which beams hit something, and the points they hit (x, y in the frame of the geometry).
+struct PreprocessedScan {
+    sensor_msgs::LaserScan::ConstPtr msg;
+    shared_ptr<const BeamTable> beams;
+    vector<unsigned char> valid;   // finite range
+    vector<float> x;
+    vector<float> y;
+    size_t validCount;
+
+    size_t size() const { return valid.size(); }
+    float range(size_t i) const { return msg->ranges[i]; }
+    float angle(size_t i) const { return beams->angles[i]; }
+    // about n beams spread over the scan: the first valid beam of every stride,
+    // strides without a valid beam are left out
+    vector<size_t> sample(int n) const;
+    // (bearing, range clamped to maxRange) of the sampled beams, the form the filter uses
+    vector<pair<float,float> > sampleMeasurements(int n, float maxRange) const;
+};
+
+// Preprocesses each scan once per process: the nodelets of one manager get the same
+// message pointer and so the same PreprocessedScan, the beam tables are kept
+// as long as the scan layout does not change. Thread safe.
+class ScanPreprocessor {
+public:
+    static shared_ptr<const PreprocessedScan> preprocess(const sensor_msgs::LaserScan::ConstPtr& msg,
+                                                         const ScanGeometry& geometry = ScanGeometry());
+};
+
+#endif // SCAN_PREPROCESSOR_H
@@ -0,0 +1,23 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H 1
+
+#include <cstddef>
+
+// Counters of the grid searches run by the calling thread.
+// Searches only add to them, callers reset them around the query they measure.
+struct SearchStats {
+    size_t searches;
+    size_t expansions;
+    size_t heapPeak;
+    double snapDistance;    // cells, the furthest occupied start/goal moved to a free cell
+    size_t roadmapHits;     // paths served by the skeleton roadmap
+
+    SearchStats(): searches(0), expansions(0), heapPeak(0), snapDistance(0), roadmapHits(0) {};
+};
+
+inline SearchStats& searchStats() {
+    static thread_local SearchStats stats;
+    return stats;
+}
+
+#endif // SEARCH_STATS_H
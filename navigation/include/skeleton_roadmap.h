@@ -0,0 +1,54 @@
+#ifndef SKELETON_ROADMAP_H
+#define SKELETON_ROADMAP_H 1
+
+#include <vector>
+#include <queue>
+#include <functional>
+
+#include <grid_map.h>
+
+using namespace std;
+
+// Skeleton (generalized Voronoi diagram) of the free space of a grid map.
+// Every free cell keeps the closest obstacle cell (brushfire), a free cell is
+// on the skeleton when its neighbour is closest to an obstacle far from its own,
+// i.e. it lies half way between two walls and has the maximum clearance.
+// Copies share their tiles, so a copy can be updated and published as a new version.
+class SkeletonRoadmap {
+public:
+    // version of the map the roadmap was built from
+    size_t version;
+
+    SkeletonRoadmap(): version(0), nx(0), ny(0) {};
+    void build(const GridMap& grid);
+    // obstacles were added to grid within [minCell, maxCell], repairs the affected part only
+    void update(const GridMap& grid, pair<int,int> minCell, pair<int,int> maxCell);
+
+    bool onSkeleton(int i, int j) const { return skeleton.get(i, j) == 1; };
+    // distance to the closest obstacle, cells
+    double clearance(int i, int j) const;
+    size_t size() const { return skeletonCells; };
+
+    // start and goal are free cells connected to the skeleton within maxConnect cells,
+    // returns an empty path if they are not connected through the skeleton
+    vector<pair<int,int> > getPath(const GridMap& grid, pair<int,int> start, pair<int,int> goal, int maxConnect) const;
+
+private:
+    // squared distance, cell index
+    typedef pair<int,int> Entry;
+    typedef priority_queue<Entry, vector<Entry>, greater<Entry> > Queue;
+
+    int nx;
+    int ny;
+    size_t skeletonCells;
+    TiledGrid<int> dist;    // squared distance to the closest obstacle cell
+    TiledGrid<int> site;    // index of the closest obstacle cell, -1 if none
+    TiledGrid<unsigned char> skeleton;  // 0 - free space, 1 - skeleton, 2 - pruned piece
+
+    void propagate(const GridMap& grid, Queue& open, pair<int,int>& minCell, pair<int,int>& maxCell);
+    void markSkeleton(const GridMap& grid, pair<int,int> minCell, pair<int,int> maxCell);
+    void prune();
+    bool connect(const GridMap& grid, pair<int,int> cell, int maxConnect, vector<pair<int,int> >& path) const;
+};
+
+#endif // SKELETON_ROADMAP_H
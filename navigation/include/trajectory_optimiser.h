@@ -0,0 +1,73 @@
+#ifndef TRAJECTORY_OPTIMISER_H
+#define TRAJECTORY_OPTIMISER_H 1
+
+#include <vector>
+
+using namespace std;
+
+// The velocities the optimiser samples and how fast they may change.
+struct TrajectoryLimits {
+    double maxLin;      // m/s, forward only
+    double maxAng;      // rad/s, both ways
+    double linStep;     // sampling steps
+    double angStep;
+    double linAcc;      // m/s^2, also the braking the clearance has to allow
+    double angAcc;      // rad/s^2
+    double period;      // s, between two commands
+    double horizon;     // s, each arc is followed this long
+
+    // maxLin is the 0.18 m/s the control loop of navigation_node is capped at
+    TrajectoryLimits(): maxLin(0.18), maxAng(1.5), linStep(0.01), angStep(0.05),
+                        linAcc(0.5), angAcc(3.0), period(0.1), horizon(1.5) {};
+};
+
+// Dynamic window local planner: every (v, w) reachable within one period is an arc,
+// scored by how it heads to and gets closer to the target, its clearance and its speed;
+// arcs that would hit an obstacle before they can brake are left out.
+// The cells every arc sweeps with the robot disc, and the arc length at which it
+// reaches them, are worked out once; a cycle rasterises the obstacles into a grid
+// around the robot and runs down the templates of the arcs in the window.
+class TrajectoryOptimiser {
+  public:
+    TrajectoryOptimiser(double p_robotRad, const TrajectoryLimits& p_limits = TrajectoryLimits());
+
+    // best (linVel, angVel) from the current command, target and obstacles in base_link;
+    // a waypoint target is passed through, any other one is stopped at
+    pair<double,double> plan(const vector<float>& obstacleX, const vector<float>& obstacleY,
+                             double targetX, double targetY, bool waypoint,
+                             double currentLin, double currentAng);
+
+    double headingWeight;
+    double progressWeight;
+    double clearanceWeight;
+    double velocityWeight;
+    // m, clearance kept beyond the braking distance
+    double margin;
+
+  private:
+    double robotRad;
+    TrajectoryLimits limits;
+    int linCount;
+    int angCount;
+
+    // obstacle grid in base_link, cells x cells of cellSize around the robot
+    double cellSize;
+    int cells;
+    vector<unsigned char> occupied;
+
+    // arc k = l*angCount + a: its end pose after the horizon, the length of its template
+    // (margin past the end) and template entries templateFirst[k] to templateFirst[k+1], sorted by cell
+    vector<float> endX;
+    vector<float> endY;
+    vector<float> endTheta;
+    vector<float> arcLength;
+    vector<int> templateFirst;
+    vector<int> templateCell;
+    vector<float> templateLength;
+
+    void buildTemplates();
+    // arc length the arc k can go before the robot touches an obstacle, arcLength[k] if none
+    float clearance(int k) const;
+};
+
+#endif // TRAJECTORY_OPTIMISER_H
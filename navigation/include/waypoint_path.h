@@ -0,0 +1,43 @@
+#ifndef WAYPOINT_PATH_H
+#define WAYPOINT_PATH_H 1
+
+#include <vector>
+
+using namespace std;
+
+// Waypoints of a path which never change once set, the progress along them is
+// kept as a cursor (the segment the robot is projected on) and an arc length.
+// advance() projects the robot on the segments within a window after the cursor,
+// so following the path costs the same per tick whatever its length.
+class WaypointPath {
+public:
+    WaypointPath(): cursor(0), progress(0) {};
+    WaypointPath(const vector<pair<double,double> >& p_points);
+
+    size_t size() const { return points.size(); };
+    bool empty() const { return points.empty(); };
+    void clear();
+    const pair<double,double>& operator[](size_t i) const { return points[i]; };
+    const pair<double,double>& back() const { return points.back(); };
+
+    // index of the first point of the segment the robot is on
+    size_t cursorIndex() const { return cursor; };
+    // arc length of the robot projection and of the whole path, m
+    double arcLength() const { return progress; };
+    double length() const { return arc.empty() ? 0 : arc.back(); };
+    double remainingLength() const { return length() - progress; };
+
+    // moves the cursor forward to the closest point on the segments starting
+    // within window (m) of arc length after it, returns the distance to the path
+    double advance(double x, double y, double window);
+    // point lookahead (m) ahead of the robot projection, the path end at most
+    pair<double,double> carrot(double lookahead) const;
+
+private:
+    vector<pair<double,double> > points;
+    vector<double> arc;     // arc length at every point
+    size_t cursor;
+    double progress;
+};
+
+#endif // WAYPOINT_PATH_H
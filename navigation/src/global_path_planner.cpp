@@ -24,9 +24,15 @@
 #include "std_msgs/MultiArrayDimension.h"
 
 #include <global_path_planner.h>
+#include <route_ordering.h>
 
 using namespace std;
 
+// 4-connected moves in the order the search expands them
+static const int STEP_X[4] = {-1, 0, 0, 1};
+static const int STEP_Y[4] = {0, -1, 1, 0};
+static const unsigned char START_CELL = 5;
+
 Node::Node(int p_x, int p_y, double p_val) : x(p_x), y(p_y), val(p_val) {};
 Node::Node() : x(-1), y(-1), val(-1) {};
 
@@ -42,8 +48,17 @@ bool operator==(const Node &a, const Node &b){
 GlobalPathPlanner::GlobalPathPlanner(const string& mapFile, float p_cellSize, float p_robotRad){
     cellSize = p_cellSize;
     robotRad = p_robotRad;
+    useRoadmap = true;
+    roadmapMinLength = 1.0;
+    roadmapConnect = 0.5;
+    smoothPaths = true;
+    smoother.tolerance = 0.02/cellSize;
+    smoother.turnRadius = 0.10/cellSize;
+    // shortcuts keep this much to the inflated obstacles where the path did
+    smoother.minClearance = 0.05/cellSize;
     setMap(mapFile);
     explorationStatus = 0;
+    explorationProgress = 0;
     mapChanged = false;
     //getExplorationPath();
 
@@ -58,85 +73,57 @@ pair<int, int> GlobalPathPlanner::getCell(double x, double y){
 }
 
 int GlobalPathPlanner::getDistance(pair<double,double> startCoord, pair<double,double> goalCoord) {
-    vector<pair<double,double> > path = getPath(startCoord, goalCoord);
+    QueryProbe probe(diagnostics.get(), "distance", startCoord, goalCoord);
+    // always the grid search, the skeleton paths of getPath are longer in cells
+    // and would change the distance at roadmapMinLength
+    shared_ptr<const GridMap> grid = map.pin();
+    vector<pair<int,int> > path = getPathGrid(*grid, getCell(startCoord.first, startCoord.second),
+                                              getCell(goalCoord.first, goalCoord.second));
+    probe.pathCells = path.size();
+    probe.found = !path.empty();
     return path.size();
 }
 
-void GlobalPathPlanner::addRobotRadiusToObstacles(double r){
+void GlobalPathPlanner::addRobotRadiusToObstacles(GridMap& grid, double r){
 
     int w = ceil(r/cellSize);
-    vector<vector<int> > f(2*w+1, vector<int>(2*w+1,0));
+    vector<pair<int,int> > disk;
     for (int i = 0; i < 2*w+1; i++){
         for (int j = 0; j < 2*w+1; j++) {
             double x = (w-i)*cellSize;
             double y = (w-j)*cellSize;
             if (pow(x,2)+pow(y,2) <= pow(r,2)) {
-                f[i][j] = 1;
-            }
-            //cout << f[i][j] << " ";
-        }
-        //cout << endl;
-    }
-    /*vector<vector<int> > sumMap(gridSize.first, vector<int>(gridSize.second, 0));
-    for (size_t i = 0; i < gridSize.first; i++){
-        for (size_t j = 0; j < gridSize.second; j++) {
-            if (i == 0 && j == 0) {
-               sumMap[i][j] = map[i][j];
-            } else if (i > 0 && j == 0) {
-               sumMap[i][j] = map[i][j] + sumMap[i-1][j];
-            } else if (i == 0 && j > 0) {
-               sumMap[i][j] = map[i][j] + sumMap[i][j-1];
-            } else {
-               sumMap[i][j] = map[i][j] + sumMap[i-1][j] + sumMap[i][j-1] - sumMap[i-1][j-1];
+                disk.push_back(pair<int,int>(i-w, j-w));
             }
         }
     }
-    for (size_t i = 0; i < gridSize.first; i++){
-        for (size_t j = 0; j < gridSize.second; j++) {
-            int sumWindow = 0;
-            if (i < w+1 && j < w+1) {
-               sumWindow = sumMap[i+w][j+w];
-            } else if (i >= w+1 && j < w+1) {
-               sumWindow = sumMap[min(i+w,gridSize.first-1)][j+w]
-                         - sumMap[i-w-1][j+w];
-            } else if (i < w+1 && j >= w+1) {
-               sumWindow = sumMap[i+w][min(j+w,gridSize.second-1)]
-                         - sumMap[i+w][j-w-1];
-            } else {
-               sumWindow = sumMap[min(i+w,gridSize.first-1)][min(j+w,gridSize.second-1)]
-                         - sumMap[i-w-1][min(j+w,gridSize.second-1)]
-                         - sumMap[min(i+w,gridSize.first-1)][j-w-1]
-                         + sumMap[i-w-1][j-w-1];
+    // stamp the disk around every wall cell of the original grid,
+    // tiles without walls are skipped
+    GridMap walls(grid);
+    int tileSize = GridMap::TILE_SIZE;
+    for (size_t ti = 0; ti < walls.tileCountX(); ti++){
+        for (size_t tj = 0; tj < walls.tileCountY(); tj++) {
+            unsigned char value;
+            if (walls.uniformTile(ti, tj, value) && value == 0) {
+                continue;
             }
-            if (sumWindow > 0) {
-                map[i][j] = 1;
-            }
-            //cout << (int)map[i][j] << " ";
-        }
-        //cout << endl;
-    }*/
-    vector<vector<int> > sumWindow(gridSize.first, vector<int>(gridSize.second, 0));
-    for (int i = 0; i < gridSize.first; i++){
-        for (int j = 0; j < gridSize.second; j++) {
-            for (int di = -w; di < w+1; di++) {
-                for (int dj = -w; dj < w+1; dj++){
-                    if (i+di >= 0 && i+di < gridSize.first && j+dj >= 0 && j+dj < gridSize.second) {
-                        sumWindow[i][j] += f[w+di][w+dj]*(int)map[i+di][j+dj];
+            int iEnd = min((int)(ti+1)*tileSize, (int)gridSize.first);
+            int jEnd = min((int)(tj+1)*tileSize, (int)gridSize.second);
+            for (int i = ti*tileSize; i < iEnd; i++){
+                for (int j = tj*tileSize; j < jEnd; j++) {
+                    if (walls.get(i, j) == 0) {
+                        continue;
+                    }
+                    for (size_t k = 0; k < disk.size(); k++) {
+                        int ii = i + disk[k].first;
+                        int jj = j + disk[k].second;
+                        if (ii >= 0 && ii < gridSize.first && jj >= 0 && jj < gridSize.second) {
+                            grid.set(ii, jj, 1);
+                        }
                     }
                 }
             }
-            //cout << sumWindow[i][j] << " ";
-        }
-        //cout << endl;
-    }
-    for (int i = 0; i < gridSize.first; i++){
-        for (int j = 0; j < gridSize.second; j++) {
-            if (sumWindow[i][j] > 0) {
-                map[i][j] = 1;
-            }
-            //cout << (int)map[i][j] << " ";
         }
-        //cout << endl;
     }
 }
 
@@ -184,7 +171,7 @@ void GlobalPathPlanner::setMap(string mapFile){
     //cout << "Grid Size = " <<  gridSize.first << " " << gridSize.second << endl;
 
     // fill the map
-    map = vector<vector<unsigned char> >(gridSize.first, vector<unsigned char>(gridSize.second,0));
+    GridMap grid(gridSize.first, gridSize.second, 0);
     double radius = max(robotRad, cellSize);
     for (size_t i = 0; i < walls.size(); i++) {
         double x1 = walls[i][0];
@@ -201,11 +188,19 @@ void GlobalPathPlanner::setMap(string mapFile){
         }
         for (size_t c = 0; c < pow(2,count)+1; c++) {
             pair<int, int> cell = getCell(x1 + c*dx, y1 + c*dy);
-            map[cell.first][cell.second] = 1;
+            grid.set(cell.first, cell.second, 1);
         }
     }
 
-    addRobotRadiusToObstacles(radius);
+    addRobotRadiusToObstacles(grid, radius);
+    map.reset(grid);
+
+    shared_ptr<SkeletonRoadmap> skeleton = make_shared<SkeletonRoadmap>();
+    skeleton->build(*map.pin());
+    atomic_store(&roadmap, shared_ptr<const SkeletonRoadmap>(skeleton));
+    stringstream s;
+    s << "Skeleton roadmap of " << skeleton->size() << " cells";
+    ROS_INFO("%s/n", s.str().c_str());
 }
 
 void GlobalPathPlanner::newWallCallback(const std_msgs::Float32MultiArray::ConstPtr& array){
@@ -234,16 +229,31 @@ void GlobalPathPlanner::updateMap(vector<double> wall){
         dy /= 2;
         count++;
     }
-    for (size_t c = 0; c < pow(2,count)+1; c++) {
-        pair<int, int> cell = getCell(x1 + c*dx, y1 + c*dy);
-        addRobotRadiusToPoint(cell);
-    }
+    lock_guard<mutex> lock(roadmapMutex);
+    // copy-on-write: planners keep using the version they pinned
+    pair<int, int> minCell = getCell(x1, y1);
+    pair<int, int> maxCell = minCell;
+    map.update([&](GridMap& grid) {
+        for (size_t c = 0; c < pow(2,count)+1; c++) {
+            pair<int, int> cell = getCell(x1 + c*dx, y1 + c*dy);
+            addRobotRadiusToPoint(grid, cell);
+            minCell = pair<int, int>(min(minCell.first, cell.first), min(minCell.second, cell.second));
+            maxCell = pair<int, int>(max(maxCell.first, cell.first), max(maxCell.second, cell.second));
+        }
+    });
     mapChanged = true;
 
+    // repair the roadmap around the new wall
+    int radCell = ceil(robotRad/cellSize);
+    shared_ptr<SkeletonRoadmap> skeleton = make_shared<SkeletonRoadmap>(*atomic_load(&roadmap));
+    skeleton->update(*map.pin(), pair<int, int>(minCell.first - radCell, minCell.second - radCell),
+                                 pair<int, int>(maxCell.first + radCell, maxCell.second + radCell));
+    atomic_store(&roadmap, shared_ptr<const SkeletonRoadmap>(skeleton));
+
 
 }
 
-void GlobalPathPlanner::addRobotRadiusToPoint(pair<int, int> xy){
+void GlobalPathPlanner::addRobotRadiusToPoint(GridMap& grid, pair<int, int> xy){
 
     int radCell = robotRad/cellSize;
     int maxX = static_cast<int>(gridSize.first);
@@ -258,7 +268,7 @@ void GlobalPathPlanner::addRobotRadiusToPoint(pair<int, int> xy){
     for (int i = startX; i <=endX; i++){
         for (int j = startY; j <=endY; j++){
             if(pow((i-xy.first)*cellSize,2) + pow((j-xy.second)*cellSize,2) <= pow(robotRad,2)){
-                map[i][j] = 1;
+                grid.set(i, j, 1);
             }
         }
     }
@@ -278,14 +288,14 @@ double GlobalPathPlanner::distanceHeuristic(const Node &a, const Node &b){
 
 
 // return distance to the closest free cell, changes goal to that cell
-double GlobalPathPlanner::findClosestFreeCell(Node& goal,int maxD){
+double GlobalPathPlanner::findClosestFreeCell(const GridMap& grid, Node& goal,int maxD){
     priority_queue<Node> cells;
     //cout << "Cell values " << endl;
     for (int dx = -maxD; dx < maxD+1; dx++) {
         for (int dy = -maxD; dy < maxD+1; dy++) {
             if (goal.x+dx >= 0 && goal.x+dx < gridSize.first &&
                 goal.y+dy >= 0 && goal.y+dy < gridSize.second &&
-                map[goal.x+dx][goal.y+dy] == 0) {
+                grid.get(goal.x+dx, goal.y+dy) == 0) {
                 Node cell(goal.x+dx, goal.y+dy,0);
                 cell.val = distanceHeuristic(goal, cell);
                 //cout << cell.val <<  " ";
@@ -296,6 +306,7 @@ double GlobalPathPlanner::findClosestFreeCell(Node& goal,int maxD){
     if (!cells.empty()) {
         Node top = cells.top();
         goal = top;
+        searchStats().snapDistance = max(searchStats().snapDistance, top.val);
         //cout << "There are free cells! Top " << top.x << " " << top.y << " "<< top.val<<endl;
         return top.val;
     } else {
@@ -307,7 +318,25 @@ double GlobalPathPlanner::findClosestFreeCell(Node& goal,int maxD){
 vector<pair<double,double> > GlobalPathPlanner::getPath(pair<double,double> startCoord, pair<double,double> goalCoord) {
     pair<int, int> startGrid = getCell(startCoord.first, startCoord.second);
     pair<int, int> goalGrid = getCell(goalCoord.first, goalCoord.second);
-    vector<pair<int,int> > pathGrid = getPathGrid(startGrid, goalGrid);
+    QueryProbe probe(diagnostics.get(), "path", startCoord, goalCoord);
+    shared_ptr<const GridMap> grid = map.pin();
+    shared_ptr<const SkeletonRoadmap> skeleton = atomic_load(&roadmap);
+    vector<pair<int,int> > pathGrid;
+    // long paths follow the skeleton, the grid search is the fallback
+    pair<int, int> startFree = startGrid;
+    pair<int, int> goalFree = goalGrid;
+    if (useRoadmap && skeleton->version == grid->version &&
+        hypot(goalCoord.first - startCoord.first, goalCoord.second - startCoord.second) > roadmapMinLength &&
+        snapToFreeCell(*grid, startFree) && snapToFreeCell(*grid, goalFree)) {
+        pathGrid = skeleton->getPath(*grid, startFree, goalFree, ceil(roadmapConnect/cellSize));
+    }
+    if (pathGrid.empty()) {
+        pathGrid = getPathGrid(*grid, startGrid, goalGrid);
+    } else {
+        searchStats().roadmapHits++;
+    }
+    probe.pathCells = pathGrid.size();
+    probe.found = !pathGrid.empty();
     vector<pair<double, double> > path;
     for (size_t i = 0; i < pathGrid.size(); i++) {
         double x = mapOffset.first+(pathGrid[i].first+0.5)*cellSize;
@@ -317,9 +346,31 @@ vector<pair<double,double> > GlobalPathPlanner::getPath(pair<double,double> star
     return path;
 }
 
+vector<pair<double,double> > GlobalPathPlanner::simplifyPath(const vector<pair<double,double> >& path) {
+    if (!smoothPaths || path.size() < 3) {
+        return path;
+    }
+    shared_ptr<const GridMap> grid = map.pin();
+    shared_ptr<const SkeletonRoadmap> skeleton = atomic_load(&roadmap);
+    const SkeletonRoadmap* clearance = 0;
+    if (skeleton && skeleton->version == grid->version) {
+        clearance = skeleton.get();
+    }
+    vector<pair<int,int> > cells;
+    for (size_t i = 0; i < path.size(); i++) {
+        cells.push_back(getCell(path[i].first, path[i].second));
+    }
+    vector<pair<double,double> > polyline = smoother.simplify(*grid, cells, clearance);
+    for (size_t i = 0; i < polyline.size(); i++) {
+        polyline[i].first = mapOffset.first + polyline[i].first*cellSize;
+        polyline[i].second = mapOffset.second + polyline[i].second*cellSize;
+    }
+    return polyline;
+}
+
 /* A* algorithm */
 // will return empty vector if path not found, and vector of length 1 if start == goal
-vector<pair<int,int> > GlobalPathPlanner::getPathGrid(pair<int,int> startCoord, pair<int,int> goalCoord) {
+vector<pair<int,int> > GlobalPathPlanner::getPathGrid(const GridMap& grid, pair<int,int> startCoord, pair<int,int> goalCoord) {
 
     size_t nx = gridSize.first;
     size_t ny = gridSize.second;
@@ -328,9 +379,9 @@ vector<pair<int,int> > GlobalPathPlanner::getPathGrid(pair<int,int> startCoord,
 
     // handle situations, when startCoord or goalCoord are in non-empty positions
     int maxD = ceil(robotRad/cellSize);
-    if (map[start.x][start.y] == 1) {
+    if (grid.get(start.x, start.y) == 1) {
        // cell is not empty, find the closest, which is within robotRad
-       double dist = findClosestFreeCell(start, maxD);
+       double dist = findClosestFreeCell(grid, start, maxD);
        if (dist*cellSize > robotRad) {
            return vector<pair<int,int> >();
        } else {
@@ -343,11 +394,11 @@ vector<pair<int,int> > GlobalPathPlanner::getPathGrid(pair<int,int> startCoord,
     //cout <<"GPP started, goal cell: "<< goal.x <<  " " <<goal.y << endl;
     double distanceTol = 0;
     maxD = ceil(robotRad/cellSize);
-    if (map[goal.x][goal.y] == 1) {
+    if (grid.get(goal.x, goal.y) == 1) {
        //cout <<"Cell is not empty! " << robotRad <<endl;
        // cell is not empty, find the closest, which is within robotRad
        Node newGoal = goal;
-       distanceTol = findClosestFreeCell(newGoal, maxD);
+       distanceTol = findClosestFreeCell(grid, newGoal, maxD);
        if (distanceTol*cellSize > robotRad) {
            return vector<pair<int,int> >();
        } else {
@@ -359,10 +410,13 @@ vector<pair<int,int> > GlobalPathPlanner::getPathGrid(pair<int,int> startCoord,
 
     start.val = distanceHeuristic(start, goal);
     priority_queue<Node> nodes;
-    vector<vector<Node> > prev_node(nx, vector<Node>(ny,Node()));
-    prev_node[start.x][start.y] = start;
+    // direction to the previous node, 0 - not visited, START_CELL - start
+    // (tiled, only the explored part of the map is allocated)
+    TiledGrid<unsigned char> prev_node(nx, ny, 0);
+    prev_node.set(start.x, start.y, START_CELL);
     nodes.push(start);
     size_t step = 0;
+    size_t heapPeak = 1;
     while (!nodes.empty()){
         Node position = nodes.top();
         nodes.pop();
@@ -372,26 +426,30 @@ vector<pair<int,int> > GlobalPathPlanner::getPathGrid(pair<int,int> startCoord,
             goal = position;
             break;
         }
-        for (int dx = -1; dx <= 1; dx += 1) {
-            for (int dy = -1; dy <= 1; dy += 1) {
-                if (abs(dx) + abs(dy) == 1 &&
-                    position.x + dx >= 0 && position.y + dy >= 0 &&
-                    position.x + dx < nx && position.y + dy < ny &&
-                    map[position.x + dx][position.y + dy] == 0 &&
-                    prev_node[position.x + dx][position.y + dy].x == -1)
-                {
-                    Node new_node(position.x + dx, position.y + dy, 0);
-                    new_node.val = position.val - dh + 1 + distanceHeuristic(new_node, goal);
-                    nodes.push(new_node);
-                    prev_node[new_node.x][new_node.y] = position;
-                }
+        for (int k = 0; k < 4; k++) {
+            int dx = STEP_X[k];
+            int dy = STEP_Y[k];
+            if (position.x + dx >= 0 && position.y + dy >= 0 &&
+                position.x + dx < nx && position.y + dy < ny &&
+                grid.get(position.x + dx, position.y + dy) == 0 &&
+                prev_node.get(position.x + dx, position.y + dy) == 0)
+            {
+                Node new_node(position.x + dx, position.y + dy, 0);
+                new_node.val = position.val - dh + 1 + distanceHeuristic(new_node, goal);
+                nodes.push(new_node);
+                prev_node.set(new_node.x, new_node.y, k + 1);
             }
         }
+        heapPeak = max(heapPeak, nodes.size());
         step++;
     }
+    SearchStats& stats = searchStats();
+    stats.searches++;
+    stats.expansions += step;
+    stats.heapPeak = max(stats.heapPeak, heapPeak);
 
     // path not found
-    if (prev_node[goal.x][goal.y].x == -1) {
+    if (prev_node.get(goal.x, goal.y) == 0) {
         return vector<pair<int,int> >();
     }
 
@@ -400,15 +458,165 @@ vector<pair<int,int> > GlobalPathPlanner::getPathGrid(pair<int,int> startCoord,
     Node node = goal;
     path.push_back(pair<int,int>(node.x,node.y));
     while (!(node.x == start.x && node.y == start.y)) {
-        node = prev_node[node.x][node.y];
+        int k = prev_node.get(node.x, node.y) - 1;
+        node.x -= STEP_X[k];
+        node.y -= STEP_Y[k];
         path.push_back(pair<int,int>(node.x,node.y));
     }
     reverse(path.begin(),path.end());
     return path;
 }
 
-void GlobalPathPlanner::sampleNodesToExplore() {
+// moves an occupied cell to the closest free one within robotRad, false if there is none
+bool GlobalPathPlanner::snapToFreeCell(const GridMap& grid, pair<int,int>& cell) {
+    if (cell.first < 0 || cell.first >= gridSize.first ||
+        cell.second < 0 || cell.second >= gridSize.second) {
+        return false;
+    }
+    if (grid.get(cell.first, cell.second) == 0) {
+        return true;
+    }
+    Node node(cell.first, cell.second, 0);
+    double dist = findClosestFreeCell(grid, node, ceil(robotRad/cellSize));
+    if (dist*cellSize > robotRad) {
+        return false;
+    }
+    cell = pair<int,int>(node.x, node.y);
+    return true;
+}
 
+/* Breadth first flood */
+// returns path lengths (in cells) from source to every target, -1 if a target is unreachable
+// stops as soon as all targets are reached
+vector<int> GlobalPathPlanner::floodDistances(const GridMap& grid, pair<int,int> source, const vector<pair<int,int> >& targets) {
+
+    int nx = gridSize.first;
+    int ny = gridSize.second;
+    vector<int> result(targets.size(), -1);
+    TiledGrid<int> dist(nx, ny, -1);
+
+    // several targets can share a cell
+    TiledGrid<int> targetCount(nx, ny, 0);
+    for (size_t t = 0; t < targets.size(); t++) {
+        int count = targetCount.get(targets[t].first, targets[t].second);
+        targetCount.set(targets[t].first, targets[t].second, count + 1);
+    }
+    size_t left = targets.size();
+
+    vector<int> queue;
+    dist.set(source.first, source.second, 0);
+    queue.push_back(source.first*ny + source.second);
+    size_t head = 0;
+    while (head < queue.size() && left > 0) {
+        int cell = queue[head++];
+        int x = cell / ny;
+        int y = cell % ny;
+        left -= targetCount.get(x, y);
+        int neighbours[4][2] = {{x-1,y}, {x+1,y}, {x,y-1}, {x,y+1}};
+        for (int k = 0; k < 4; k++) {
+            int i = neighbours[k][0];
+            int j = neighbours[k][1];
+            if (i >= 0 && i < nx && j >= 0 && j < ny &&
+                grid.get(i, j) == 0 && dist.get(i, j) == -1) {
+                dist.set(i, j, dist.get(x, y) + 1);
+                queue.push_back(i*ny + j);
+            }
+        }
+    }
+
+    // the queue keeps every reached cell
+    SearchStats& stats = searchStats();
+    stats.searches++;
+    stats.expansions += head;
+    stats.heapPeak = max(stats.heapPeak, queue.size());
+    for (size_t t = 0; t < targets.size(); t++) {
+        result[t] = dist.get(targets[t].first, targets[t].second);
+    }
+    return result;
+}
+
+// finds a short order to visit all targets from startCoord
+// returns indices of reachable targets in visiting order, path is the stitched global path
+vector<int> GlobalPathPlanner::getRoute(pair<double,double> startCoord, const vector<pair<double,double> >& targets,
+                                       double timeBudget, vector<pair<double,double> >& path) {
+
+    auto start = chrono::high_resolution_clock::now();
+    QueryProbe probe(diagnostics.get(), "route", startCoord, startCoord);
+    path.clear();
+    shared_ptr<const GridMap> grid = map.pin();
+
+    pair<int,int> startCell = getCell(startCoord.first, startCoord.second);
+    if (!snapToFreeCell(*grid, startCell)) {
+        return vector<int>();
+    }
+
+    // snap targets and keep the ones reachable from the start
+    vector<pair<int,int> > cells;
+    vector<int> index;
+    for (size_t t = 0; t < targets.size(); t++) {
+        pair<int,int> cell = getCell(targets[t].first, targets[t].second);
+        if (snapToFreeCell(*grid, cell)) {
+            cells.push_back(cell);
+            index.push_back(t);
+        }
+    }
+    vector<int> fromStart = floodDistances(*grid, startCell, cells);
+    vector<pair<int,int> > reachable(1, startCell);
+    vector<int> reachableIndex;
+    for (size_t t = 0; t < cells.size(); t++) {
+        if (fromStart[t] != -1) {
+            reachable.push_back(cells[t]);
+            reachableIndex.push_back(index[t]);
+        }
+    }
+
+    // distance matrix, node 0 is the start
+    int n = reachable.size();
+    vector<vector<int> > dist(n, vector<int>(n, 0));
+    for (int i = 0; i < n; i++) {
+        vector<int> row = floodDistances(*grid, reachable[i], reachable);
+        for (int j = 0; j < n; j++) {
+            dist[i][j] = row[j];
+        }
+    }
+    auto matrixEnd = chrono::high_resolution_clock::now();
+    chrono::duration<double> matrixTime = matrixEnd - start;
+
+    vector<int> tour = orderRoute(dist, max(0.0, timeBudget - matrixTime.count()));
+
+    // stitch the legs
+    vector<int> order;
+    pair<int,int> from = startCell;
+    vector<pair<int,int> > pathGrid(1, startCell);
+    for (size_t k = 0; k < tour.size(); k++) {
+        pair<int,int> to = reachable[tour[k]];
+        vector<pair<int,int> > part = getPathGrid(*grid, from, to);
+        if (part.size() > 1) {
+            pathGrid.insert(pathGrid.end(), part.begin() + 1, part.end());
+        }
+        order.push_back(reachableIndex[tour[k]-1]);
+        from = to;
+    }
+    for (size_t i = 0; i < pathGrid.size(); i++) {
+        double x = mapOffset.first+(pathGrid[i].first+0.5)*cellSize;
+        double y = mapOffset.second+(pathGrid[i].second+0.5)*cellSize;
+        path.push_back(pair<double,double>(x,y));
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    stringstream s;
+    s << "Route through " << order.size() << " of " << targets.size() << " targets, length " << pathGrid.size()
+      << ", distance matrix " << matrixTime.count() << " s, total " << elapsed.count() << " s";
+    ROS_INFO("%s/n", s.str().c_str());
+    probe.pathCells = pathGrid.size();
+    probe.found = !order.empty();
+    return order;
+}
+
+void GlobalPathPlanner::sampleNodesToExplore(vector<Node>& nodes) {
+
+    shared_ptr<const GridMap> grid = map.pin();
     double cellSizeL = 0.5;
     pair<int, int> gridSizeL(ceil(mapScale.first/cellSizeL), ceil(mapScale.second/cellSizeL));
     for (int i = 0; i < gridSizeL.first; i++) {
@@ -416,33 +624,35 @@ void GlobalPathPlanner::sampleNodesToExplore() {
             pair<int, int> coord = getCell((i+0.5)*cellSizeL,(j+0.5)*cellSizeL);
             Node cell(coord.first,coord.second,0);
             int maxD = round(cellSizeL/cellSize);
-            double distance = findClosestFreeCell(cell,maxD);
+            double distance = findClosestFreeCell(*grid, cell,maxD);
             if (distance <= maxD) {
                 nodes.push_back(cell);
             }
         }
     }
 
-    writeNodesToFile();
+    writeNodesToFile(nodes);
 }
 
-void GlobalPathPlanner::computeExplorationPath() {
+void GlobalPathPlanner::computeExplorationPath(ExplorationPlan& plan) {
 
     cout << "Compute exploration path " << endl;
 
     auto start = chrono::high_resolution_clock::now();
+    // the whole path is computed on one version of the map
+    shared_ptr<const GridMap> grid = map.pin();
     // the first node should be a starting location
     // remove all other nodes, which cant be reached from it
     vector<int> edges1;
     edges1.push_back(0);
     int i = 1;
-    while(i < nodes.size()) {
-        vector<pair<int, int> > path = getPathGrid(pair<int,int>(nodes[0].x,nodes[0].y), pair<int,int>(nodes[i].x,nodes[i].y));
+    while(i < plan.nodes.size()) {
+        vector<pair<int, int> > path = getPathGrid(*grid, pair<int,int>(plan.nodes[0].x,plan.nodes[0].y), pair<int,int>(plan.nodes[i].x,plan.nodes[i].y));
         if (path.size()>0) {
             edges1.push_back(path.size());
             i++;
         } else {
-            nodes.erase(nodes.begin()+i);
+            plan.nodes.erase(plan.nodes.begin()+i);
         }
     }
 
@@ -475,21 +685,21 @@ void GlobalPathPlanner::computeExplorationPath() {
     //s << "Time to compute the distance matrix = " << elapsed.count()<< endl;
     //ROS_INFO("%s/n", s.str().c_str());
 
-    vector<int> visited(nodes.size(),0);
+    vector<int> visited(plan.nodes.size(),0);
     vector<int> path;
     int count = 1;
     i = 0;
     path.push_back(i);
     visited[i] = 1;
-    while (count < nodes.size()) {
+    while (count < plan.nodes.size()) {
         int jMin = -1;
-        vector<int> edges(nodes.size(),-1);
-        for (int j = 0; j < nodes.size(); j++) {
+        vector<int> edges(plan.nodes.size(),-1);
+        for (int j = 0; j < plan.nodes.size(); j++) {
             if (visited[j] ==0) {
                 if (i == 0) {
                     edges[j] = edges1[j];
                 } else {
-                    vector<pair<int, int> > path = getPathGrid(pair<int,int>(nodes[i].x,nodes[i].y), pair<int,int>(nodes[j].x,nodes[j].y));
+                    vector<pair<int, int> > path = getPathGrid(*grid, pair<int,int>(plan.nodes[i].x,plan.nodes[i].y), pair<int,int>(plan.nodes[j].x,plan.nodes[j].y));
                     if (path.size()>0) {
                         edges[j] = path.size();
                     }
@@ -515,35 +725,32 @@ void GlobalPathPlanner::computeExplorationPath() {
 
     vector<pair<int,int> > pathGrid;
     cout << "Path : "<< endl;
-    nodeMarks.push_back(pair<int,int>(path[0],0));
+    plan.nodeMarks.push_back(pair<int,int>(path[0],0));
     for (int i = 0; i < path.size()-1; i++) {
         cout << path[i+1] << " ";
-        vector<pair<int, int> > part = getPathGrid(pair<int,int>(nodes[path[i]].x,nodes[path[i]].y), pair<int,int>(nodes[path[i+1]].x,nodes[path[i+1]].y));
+        vector<pair<int, int> > part = getPathGrid(*grid, pair<int,int>(plan.nodes[path[i]].x,plan.nodes[path[i]].y), pair<int,int>(plan.nodes[path[i+1]].x,plan.nodes[path[i+1]].y));
         pathGrid.insert(pathGrid.end(), part.begin(), part.end());
-        nodeMarks.push_back(pair<int,int>(path[i+1], pathGrid.size()-1));
+        plan.nodeMarks.push_back(pair<int,int>(path[i+1], pathGrid.size()-1));
     }
     if (pathGrid.size() == 0) {
-        pair<int,int> pos(nodes[path[0]].x,nodes[path[0]].y);
+        pair<int,int> pos(plan.nodes[path[0]].x,plan.nodes[path[0]].y);
         pathGrid.push_back(pos);
     }
     cout << "Path size = " << path.size() << endl;
 
-    int pathSize = pathGrid.size();
-    for (int i = 0; i < nodeMarks.size(); i++) {
-        nodeMarks[i].second = pathSize - nodeMarks[i].second;
-    }
-    cout << "Node marks size = " << nodeMarks.size() << endl;
+    cout << "Node marks size = " << plan.nodeMarks.size() << endl;
 
+    plan.progress = 0;
     for (size_t i = 0; i < pathGrid.size(); i++) {
         double x = mapOffset.first+(pathGrid[i].first+0.5)*cellSize;
         double y = mapOffset.second+(pathGrid[i].second+0.5)*cellSize;
-        explorationPath.push_back(pair<double,double>(x,y));
+        plan.path.push_back(pair<double,double>(x,y));
     }
 
 }
 
 // generates nodes and finds an exploration path through them
-void GlobalPathPlanner::getExplorationPath(double x, double y) {
+void GlobalPathPlanner::getExplorationPath(ExplorationPlan& plan, double x, double y) {
 
     string msg = "Generating an exploration path ...... ";
     ROS_INFO("%s/n", msg.c_str());
@@ -551,41 +758,51 @@ void GlobalPathPlanner::getExplorationPath(double x, double y) {
     pair<int, int> cell = getCell(x,y);
     Node startNode(cell.first,cell.second,0);
 
-    sampleNodesToExplore();
-    nodes.insert(nodes.begin(),startNode);
+    sampleNodesToExplore(plan.nodes);
+    plan.nodes.insert(plan.nodes.begin(),startNode);
 
-    computeExplorationPath();
+    computeExplorationPath(plan);
 
 }
 
-void GlobalPathPlanner::recalculateExplorationPath(double x, double y) {
-    if (!mapChanged) {
-        pair<double, double>  pathStart = explorationPath[0];
+void GlobalPathPlanner::recalculateExplorationPath(ExplorationPlan& plan, double x, double y) {
+    // a wall added while this runs marks the map changed for the next time
+    bool changed = mapChanged.exchange(false);
+    plan.mapChanged = plan.mapChanged || changed;
+    if (!changed && plan.progress < plan.path.size()) {
+        pair<double, double>  pathStart = plan.path[plan.progress];
         pair<double, double> location(x,y);
         cout << "Recalculate exploration, map did not change "<< x << " "<< y << " to "<< pathStart.first << " " << pathStart.second << endl;
         vector<pair<double, double> > path = getPath(location, pathStart);
         cout << "Path size " << path.size() << endl;
-        explorationPath.insert(explorationPath.begin(),path.begin(), path.end());
-        cout << "Exploration path size " << explorationPath.size() << endl;
+        // path to the point reached last, then the rest of the exploration path
+        int shift = path.size() - plan.progress;
+        path.insert(path.end(), plan.path.begin() + plan.progress, plan.path.end());
+        plan.path.swap(path);
+        plan.progress = 0;
+        for (size_t i = 0; i < plan.nodeMarks.size(); i++) {
+            plan.nodeMarks[i].second += shift;
+        }
+        cout << "Exploration path size " << plan.path.size() << endl;
     } else {
         cout << "Recalculate exploration, map changed" << endl;
         // delete nodes, which are already visited
-        int pathSize = explorationPath.size();
-        int i = 0;
+        size_t i = 0;
         vector<int> nodesToErase;
-        while (nodeMarks[i].second > pathSize) {
-            nodesToErase.push_back(nodeMarks[i].first);
+        while (i < plan.nodeMarks.size() && plan.nodeMarks[i].second < (int)plan.progress) {
+            nodesToErase.push_back(plan.nodeMarks[i].first);
             i++;
         }
         // move and possibly delete nodes which were influenced by wall adding
+        shared_ptr<const GridMap> grid = map.pin();
         int maxD = round(robotRad/cellSize);
-        for (int i = 0; i < nodes.size(); i++) {
-            Node n = nodes[i];
-            double distance = findClosestFreeCell(n,maxD);
+        for (int i = 0; i < plan.nodes.size(); i++) {
+            Node n = plan.nodes[i];
+            double distance = findClosestFreeCell(*grid, n,maxD);
             if (distance > maxD) {
                 nodesToErase.push_back(i);
             } else {
-                nodes[i] = n;
+                plan.nodes[i] = n;
             }
         }
 
@@ -593,41 +810,73 @@ void GlobalPathPlanner::recalculateExplorationPath(double x, double y) {
         if (nodesToErase.size()>0) {
             sort(nodesToErase.begin(), nodesToErase.end());
             for(int i = nodesToErase.size()-1; i>=0; i--) {
-                nodes.erase(nodes.begin()+ nodesToErase[i]);
+                plan.nodes.erase(plan.nodes.begin()+ nodesToErase[i]);
             }
         }
-        explorationPath.clear();
-        nodeMarks.clear();
-        cout << "nodes left "<< nodes.size() << endl;
-        writeNodesToFile();
+        plan.path.clear();
+        plan.nodeMarks.clear();
+        cout << "nodes left "<< plan.nodes.size() << endl;
+        writeNodesToFile(plan.nodes);
 
         pair<int, int> cell = getCell(x,y);
         Node startNode(cell.first,cell.second,0);
-        nodes.insert(nodes.begin(),startNode);
-        computeExplorationPath();
-        mapChanged = false;
+        plan.nodes.insert(plan.nodes.begin(),startNode);
+        computeExplorationPath(plan);
         //cout << "Computation finished!! " << endl;
     }
 }
 
-void GlobalPathPlanner::explorationUpdate(double x, double y, double theta, int pathSize) {
-    // erase part of the path, already explored
-    int offset = explorationPath.size() - pathSize;
-    explorationPath.erase(explorationPath.begin(),explorationPath.begin()+offset);
+void GlobalPathPlanner::explorationUpdate(double x, double y, double theta, size_t cursor) {
+    // the part of the path before the cursor is already explored
+    explorationProgress = cursor;
 }
 
 void GlobalPathPlanner::explorationCallback(bool start_exploration, double x, double y){
+    ExplorationPlan plan = explorationSnapshot();
+    planExploration(plan, start_exploration, x, y);
+    applyExploration(plan);
+}
+
+ExplorationPlan GlobalPathPlanner::explorationSnapshot() const {
+    ExplorationPlan plan;
+    plan.status = explorationStatus;
+    plan.nodes = nodes;
+    plan.path = explorationPath;
+    plan.progress = explorationProgress;
+    plan.nodeMarks = nodeMarks;
+    plan.mapChanged = false;
+    return plan;
+}
+
+void GlobalPathPlanner::planExploration(ExplorationPlan& plan, bool start_exploration, double x, double y){
     if (start_exploration) {
-        if (explorationStatus == 0) {
-            getExplorationPath(x, y);
-            explorationStatus = 1;
+        QueryProbe probe(diagnostics.get(), "exploration", pair<double,double>(x,y), pair<double,double>(x,y));
+        if (plan.status == 0) {
+            getExplorationPath(plan, x, y);
+            plan.status = 1;
         } else {
-            recalculateExplorationPath(x, y);
-            explorationStatus = 1;
+            recalculateExplorationPath(plan, x, y);
+            plan.status = 1;
         }
+        probe.pathCells = plan.path.size();
+        probe.found = !plan.path.empty();
     } else {
         // stop exploration
-        explorationStatus = 2;
+        plan.status = 2;
+    }
+}
+
+void GlobalPathPlanner::applyExploration(const ExplorationPlan& plan) {
+    explorationStatus = plan.status;
+    nodes = plan.nodes;
+    explorationPath = plan.path;
+    explorationProgress = plan.progress;
+    nodeMarks = plan.nodeMarks;
+}
+
+void GlobalPathPlanner::discardExploration(const ExplorationPlan& plan) {
+    if (plan.mapChanged) {
+        mapChanged = true;
     }
 }
 
@@ -635,7 +884,7 @@ void GlobalPathPlanner::explorationCallback(bool start_exploration, double x, do
 
 #include <fstream>
 
-void GlobalPathPlanner::writeNodesToFile() {
+void GlobalPathPlanner::writeNodesToFile(const vector<Node>& nodes) {
 
     string filename = "navigation_nodes.txt";
 
@@ -0,0 +1,16 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <atomic>
+
+#include <local_map_node.h>
+
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "local_map_node");
+
+    ros::NodeHandle n;
+    std::atomic<bool> running(true);
+    runLocalMapNode(n, *ros::getGlobalCallbackQueue(), running);
+
+    return 0;
+}
@@ -0,0 +1,667 @@
+/*
+ *  local_path_planner.cpp
+ *
+ *
+ *  Created on: Nov 1, 2017
+ *  Authors:   Jevgenija Aksjonova
+ *            jevaks <at> kth.se
+ */
+
+#include "ros/ros.h"
+#include "std_msgs/Bool.h"
+#include "sensor_msgs/LaserScan.h"
+#include "math.h"
+#include "project_msgs/direction.h"
+#include "project_msgs/stop.h"
+#include "project_msgs/depth.h"
+#include <nav_msgs/Odometry.h>
+#include <tf/transform_broadcaster.h>
+#include <visualization_msgs/Marker.h>
+#include <visualization_msgs/MarkerArray.h>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+#include <local_path_planner.h>
+
+using namespace std;
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::stop(int reason) {
+    project_msgs::stop msg;
+    msg.stamp = ros::Time::now();
+    msg.stop = true;
+    msg.reason = reason;
+    stopPub.publish(msg);
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::buildRemap(const shared_ptr<const BeamTable>& table) {
+
+    // The lidar is not at the centre, so the bin of a hit depends on its range:
+    // it is the bin of the beam far away and moves towards the bin of the lidar
+    // as the range gets shorter. The ranges where it crosses into another bin
+    // are where the beam meets the bin borders.
+    const BeamTable& beams = *table;
+    double px = beams.geometry.x;
+    double py = beams.geometry.y;
+    offset2 = px*px + py*py;
+    beamProjection.assign(beams.size, 0);
+    farBin.assign(beams.size, 0);
+    remapFirst.assign(beams.size + 1, 0);
+    remapThreshold.clear();
+    remapBin.clear();
+    vector<double> crossings;
+    for (size_t i = 0; i < beams.size; i++) {
+        double ux = beams.cosAngles[i];
+        double uy = beams.sinAngles[i];
+        beamProjection[i] = px*ux + py*uy;
+        farBin[i] = Polar::bin(beams.angles[i]);
+
+        crossings.clear();
+        for (int k = 0; k < Bins; k++) {
+            double cosBorder = Polar::tables().cosBorder[k];
+            double sinBorder = Polar::tables().sinBorder[k];
+            double denominator = ux*sinBorder - uy*cosBorder;
+            if (fabs(denominator) < 1e-12) {
+                continue;
+            }
+            double r = (py*cosBorder - px*sinBorder)/denominator;
+            if (r > 0 && (px + r*ux)*cosBorder + (py + r*uy)*sinBorder > 0) {
+                crossings.push_back(r);
+            }
+        }
+        // a beam through the centre jumps to the opposite bin there
+        if (fabs(px*uy - py*ux) < 1e-12 && -beamProjection[i] > 0) {
+            crossings.push_back(-beamProjection[i]);
+        }
+        sort(crossings.begin(), crossings.end(), greater<double>());
+
+        remapFirst[i] = remapThreshold.size();
+        for (size_t k = 0; k < crossings.size(); k++) {
+            double below = (k + 1 < crossings.size()) ? (crossings[k] + crossings[k+1])/2 : crossings[k]/2;
+            remapThreshold.push_back(crossings[k]);
+            remapBin.push_back(Polar::bin(atan2(py + below*uy, px + below*ux)));
+        }
+    }
+    remapFirst[beams.size] = remapThreshold.size();
+    beamSpan = max(1, (int)round(beams.angleIncrement/(2*M_PI/Bins)));
+    remapBeams = table;
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::mapLidar(double rad) {
+
+    fill(occupied.begin(), occupied.end(), 0.0f);
+    fill(distance.begin(), distance.end(), 0.0f);
+    const PreprocessedScan& points = *scan;
+    for (size_t i = 0; i < points.size(); i++) {
+        if (points.valid[i]) {
+            double range = points.range(i);
+            double r = sqrt(range*range + 2*range*beamProjection[i] + offset2);
+            int angleInd = farBin[i];
+            for (int k = remapFirst[i]; k < remapFirst[i+1] && range < remapThreshold[k]; k++) {
+                angleInd = remapBin[k];
+            }
+            // bins narrower than the beams get the hit in all the bins the beam covers
+            for (int b = angleInd - (beamSpan - 1)/2; b <= angleInd + beamSpan/2; b++) {
+                occupied[Polar::wrap(b)] = (r <= rad) ? 1.0 : 0.0;
+                distance[Polar::wrap(b)] = r;
+            }
+        }
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::filterNoise() {
+
+    // an obstacle bin is kept if at least w+1 bins of its window are obstacles,
+    // the count slides along with the window
+    int w = Polar::fromDegrees(3); // window width = 2*w +1
+    int count = 0;
+    for (int j = -w; j <= w; j++) {
+        count += (occupied[Polar::wrap(j)] > 0);
+    }
+    for (int i = 0; i < Bins; i++) {
+        filtered[i] = (occupied[i] > 0 && count < w+1) ? 0.0 : occupied[i];
+        count += (occupied[Polar::wrap(i+w+1)] > 0) - (occupied[Polar::wrap(i-w)] > 0);
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::addDepth(double rad) {
+
+    fill(distanceDepth.begin(), distanceDepth.end(), 0.0f);
+    depthObstacles.expire(ros::Time::now().toSec() - depthLifetime);
+    depthObstacles.project(locX, locY, locTheta, rangesDepth, anglesDepth);
+    int l = depthObstacles.size();
+    for (int i = 0; i < l; i++) {
+        double r = rangesDepth[i];
+        int ind = Polar::bin(anglesDepth[i]);
+        if (r <= rad) {
+            filtered[ind] = 1.0;
+        }
+        if (distanceDepth[ind] > 0) {
+            distanceDepth[ind] = min(r, (double)distanceDepth[ind]);
+        } else {
+            distanceDepth[ind] = r;
+        }
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::useRollingGrid(double side, double cellSize) {
+
+    int cells = round(side/cellSize);
+    grid = make_shared<RollingGrid>(cellSize, cells, depthLifetime);
+    grid->moveTo(locX, locY);
+    vector<pair<float,int> > order;
+    for (int dy = -cells/2; dy < cells - cells/2; dy++) {
+        for (int dx = -cells/2; dx < cells - cells/2; dx++) {
+            order.push_back(pair<float,int>(hypot(dx, dy)*cellSize, order.size()));
+        }
+    }
+    sort(order.begin(), order.end());
+    gridOffsetX.clear();
+    gridOffsetY.clear();
+    gridOffsetRange.clear();
+    gridOffsetAngle.clear();
+    for (size_t k = 0; k < order.size(); k++) {
+        int dx = order[k].second % cells - cells/2;
+        int dy = order[k].second / cells - cells/2;
+        gridOffsetX.push_back(dx);
+        gridOffsetY.push_back(dy);
+        gridOffsetRange.push_back(order[k].first);
+        gridOffsetAngle.push_back(atan2(dy, dx));
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::updateGrid() {
+
+    grid->moveTo(locX, locY);
+    grid->decay(ros::Time::now().toSec());
+    // the scan points are in base_link, the grid is in odom
+    double c = cos(locTheta);
+    double s = sin(locTheta);
+    const PreprocessedScan& points = *scan;
+    double sensorX = locX + c*points.beams->geometry.x - s*points.beams->geometry.y;
+    double sensorY = locY + s*points.beams->geometry.x + c*points.beams->geometry.y;
+    for (size_t i = 0; i < points.size(); i++) {
+        if (points.valid[i]) {
+            double x = locX + c*points.x[i] - s*points.y[i];
+            double y = locY + s*points.x[i] + c*points.y[i];
+            grid->castRay(RollingGrid::LIDAR, sensorX, sensorY, x, y, true);
+        }
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::mapGrid(double rad) {
+
+    // the cells closest first, so the first occupied cell of a bin is its distance;
+    // bearings are taken from the centre of the robot's cell
+    fill(occupied.begin(), occupied.end(), 0.0f);
+    fill(distance.begin(), distance.end(), 0.0f);
+    int cx = grid->centreX();
+    int cy = grid->centreY();
+    for (size_t k = 0; k < gridOffsetRange.size() && gridOffsetRange[k] <= rad; k++) {
+        if (grid->occupied(cx + gridOffsetX[k], cy + gridOffsetY[k])) {
+            int ind = Polar::bin(gridOffsetAngle[k] - locTheta);
+            if (occupied[ind] == 0) {
+                occupied[ind] = 1.0;
+                distance[ind] = gridOffsetRange[k];
+            }
+        }
+    }
+}
+
+// half-width (bins) of the obstacle seen at distance d, as the robot radius covers it
+template <int Bins>
+static int halfWidth(double radius, double d) {
+    return (asin((radius)/max(d,radius))/2.0/M_PI*Bins);
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::buildWidthTable(double radius, vector<double>& widths) {
+
+    // widths[k-1] is the largest distance with half-width >= k, found by bisection
+    // on halfWidth itself so the table gives exactly the same widths
+    widths.assign(Polar::quarter, -1);
+    for (int k = 1; k <= Polar::quarter; k++) {
+        double lo = radius/2;
+        double hi = 1e6;
+        if (halfWidth<Bins>(radius, lo) < k) {
+            continue;
+        }
+        while (true) {
+            double mid = lo + (hi - lo)/2;
+            if (mid <= lo || mid >= hi) {
+                break;
+            }
+            if (halfWidth<Bins>(radius, mid) >= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        widths[k-1] = lo;
+    }
+}
+
+template <int Bins>
+int PolarLocalPathPlanner<Bins>::width(const vector<double>& widths, double d) {
+    // descending, so the entries >= d are a prefix
+    return upper_bound(widths.begin(), widths.end(), d, greater<double>()) - widths.begin();
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::sweepRobotRadius(bool clockwise) {
+
+    // starts a quarter circle (the widest half-width) early to wrap around bin 0
+    int candidates = 0;
+    for (int p = -Polar::quarter; p < Bins; p++) {
+        int i = clockwise ? Polar::wrap(p) : Polar::wrap(Bins - 1 - p);
+        if (binMaxWidth[i] >= 0) {
+            int end = p + binMaxWidth[i] + 1;
+            int ramp = binMaxWidth[i] + 1 - binMinWidth[i];
+            bool covered = false;
+            for (int c = 0; c < candidates && !covered; c++) {
+                covered = candidateReach[c] >= end && candidateRamp[c] <= ramp;
+            }
+            // the list is changed only once covered is known, a line equal to a
+            // candidate must not overwrite it while the rest is still compared
+            if (!covered) {
+                int kept = 0;
+                for (int c = 0; c < candidates; c++) {
+                    if (candidateReach[c] > end || candidateRamp[c] < ramp) {
+                        candidateReach[kept] = candidateReach[c];
+                        candidateRamp[kept] = candidateRamp[c];
+                        kept++;
+                    }
+                }
+                candidateReach[kept] = end;
+                candidateRamp[kept] = ramp;
+                candidates = kept + 1;
+            }
+        }
+        if (p < 0) {
+            continue;
+        }
+        int kept = 0;
+        for (int c = 0; c < candidates; c++) {
+            int reach = candidateReach[c] - p;
+            if (reach <= 0) {
+                continue;
+            }
+            if (reach*bestRamp[i] > bestReach[i]*candidateRamp[c]) {
+                bestReach[i] = reach;
+                bestRamp[i] = candidateRamp[c];
+            }
+            candidateReach[kept] = candidateReach[c];
+            candidateRamp[kept] = candidateRamp[c];
+            kept++;
+        }
+        candidates = kept;
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::addRobotRadius(double rad, vector<float>& localMap) {
+
+    localMap.assign(filtered.begin(), filtered.end());
+    for (int i = 0; i < Bins; i++) {
+        binMaxWidth[i] = -1;
+        if (filtered[i] > 0) {
+
+            double d = rad;
+            if (distance[i]>0) {
+                d =distance[i];
+            }
+            if (distanceDepth[i]>0) {
+                d = min(d,(double)distanceDepth[i]);
+            }
+            binMaxWidth[i] = width(maxWidth, d);
+            binMinWidth[i] = width(minWidth, d);
+        }
+        bestReach[i] = 0;
+        bestRamp[i] = 1;
+    }
+    sweepRobotRadius(true);
+    sweepRobotRadius(false);
+
+    for (int i = 0; i < Bins; i++) {
+        if (bestReach[i] > 0) {
+            float value;
+            if (bestReach[i] >= bestRamp[i]) {
+                value = 1;
+            } else {
+                value = bestReach[i]/(float)bestRamp[i];
+            }
+            localMap[i] = max(localMap[i],value);
+        }
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::updateLocalMapLidar() {
+
+    // lidar -> noise filter -> depth -> robot radius, over buffers allocated once
+    if (scan->beams != remapBeams) {
+        buildRemap(scan->beams);
+    }
+    double rad = mapRad;
+    if (grid) {
+        // the grid already weighs the hits, no noise filter
+        updateGrid();
+        mapGrid(rad);
+        filtered.assign(occupied.begin(), occupied.end());
+        fill(distanceDepth.begin(), distanceDepth.end(), 0.0f);
+    } else {
+        mapLidar(rad);
+        filterNoise();
+        addDepth(rad);
+    }
+
+    shared_ptr<LocalMap> localMap;
+    for (size_t k = 0; k < mapBuffers.size() && !localMap; k++) {
+        if (mapBuffers[k].use_count() == 1) {
+            localMap = mapBuffers[k];
+        }
+    }
+    if (!localMap) {
+        localMap = make_shared<LocalMap>();
+        mapBuffers.push_back(localMap);
+    }
+    addRobotRadius(rad, localMap->bins);
+    indexHeadings(*localMap);
+    collectPoints(localMap->points);
+    atomic_store(&localMapProcessed, shared_ptr<const LocalMap>(localMap));
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::collectPoints(ObstaclePoints& points) {
+
+    points.x.clear();
+    points.y.clear();
+    if (grid) {
+        double c = cos(locTheta);
+        double s = sin(locTheta);
+        double size = grid->cellSize();
+        int cx = grid->centreX();
+        int cy = grid->centreY();
+        for (size_t k = 0; k < gridOffsetRange.size() && gridOffsetRange[k] <= pointRange; k++) {
+            if (grid->occupied(cx + gridOffsetX[k], cy + gridOffsetY[k])) {
+                double dx = gridOffsetX[k]*size;
+                double dy = gridOffsetY[k]*size;
+                points.x.push_back(c*dx + s*dy);
+                points.y.push_back(c*dy - s*dx);
+            }
+        }
+        return;
+    }
+    const PreprocessedScan& beams = *scan;
+    for (size_t i = 0; i < beams.size(); i++) {
+        if (beams.valid[i] && beams.range(i) <= pointRange) {
+            points.x.push_back(beams.x[i]);
+            points.y.push_back(beams.y[i]);
+        }
+    }
+    // projected by addDepth for this update
+    for (size_t i = 0; i < depthObstacles.size(); i++) {
+        if (rangesDepth[i] <= pointRange) {
+            points.x.push_back(rangesDepth[i]*cos(anglesDepth[i]));
+            points.y.push_back(rangesDepth[i]*sin(anglesDepth[i]));
+        }
+    }
+}
+
+template <int Bins>
+shared_ptr<const ObstaclePoints> PolarLocalPathPlanner<Bins>::obstaclePoints() {
+    shared_ptr<const LocalMap> localMap = atomic_load(&localMapProcessed);
+    if (!localMap) {
+        return shared_ptr<const ObstaclePoints>();
+    }
+    // shares the snapshot, its buffers are not reused while the points are held
+    return shared_ptr<const ObstaclePoints>(localMap, &localMap->points);
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::runs(const vector<float>& bins, double above, bool uphill,
+                                       vector<int>& left, vector<int>& right) {
+    // each run is one longer than the run of the next bin, counted from a bin where it breaks
+    int breakLeft = -1;
+    int breakRight = -1;
+    for (int x = 0; x < Bins; x++) {
+        bool high = bins[x] > above;
+        if (breakLeft < 0 && !(high && (!uphill || bins[x] >= bins[Polar::wrap(x-1)]))) {
+            breakLeft = x;
+        }
+        if (breakRight < 0 && !(high && (!uphill || bins[x] >= bins[Polar::wrap(x+1)]))) {
+            breakRight = x;
+        }
+    }
+    if (breakLeft < 0) {
+        fill(left.begin(), left.end(), Bins);
+    } else {
+        left[breakLeft] = 0;
+        for (int k = 1; k < Bins; k++) {
+            int x = Polar::wrap(breakLeft + k);
+            int previous = Polar::wrap(x-1);
+            bool cont = bins[x] > above && (!uphill || bins[x] >= bins[previous]);
+            left[x] = cont ? left[previous] + 1 : 0;
+        }
+    }
+    if (breakRight < 0) {
+        fill(right.begin(), right.end(), Bins);
+    } else {
+        right[breakRight] = 0;
+        for (int k = 1; k < Bins; k++) {
+            int x = Polar::wrap(breakRight - k);
+            int next = Polar::wrap(x+1);
+            bool cont = bins[x] > above && (!uphill || bins[x] >= bins[next]);
+            right[x] = cont ? right[next] + 1 : 0;
+        }
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::indexHeadings(LocalMap& localMap) {
+
+    // amendDirection for every heading at once: it walks away from the heading while
+    // the bins are blocked (> 0.3) and not falling, half a circle at most, and
+    // if that is blocked both ways it walks while the bins are fully blocked (> 0.9)
+    const vector<float>& bins = localMap.bins;
+    runs(bins, 0.3, true, runLeft, runRight);
+    runs(bins, 0.9, false, blockedLeft, blockedRight);
+    for (int a = 0; a < Bins; a++) {
+        Heading& heading = localMap.headings[a];
+        int left = min(runLeft[a], Polar::half + 1);
+        int right = min(runRight[a], Polar::half + 1);
+        heading.deviation = left > Polar::quarter && right > Polar::quarter &&
+                            left + right > Polar::fromDegrees(190);
+        heading.blocked = false;
+        if (left > Polar::half && right > Polar::half) {
+            left = min(blockedLeft[a], Polar::half + 1);
+            right = min(blockedRight[a], Polar::half + 1);
+            heading.blocked = left > Polar::half && right > Polar::half;
+        }
+        heading.left = -left;
+        heading.right = right;
+        if (bins[a] < 1.0) {
+            heading.amended = (bins[Polar::wrap(a-left)] < bins[Polar::wrap(a+right)]) ? -left : right;
+        } else {
+            heading.amended = (left >= right) ? right : -left;
+        }
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::emergencyStopLidar() {
+    if (!safetyZone.built(scan->beams)) {
+        vector<float> staticMin(scan->size(), INFINITY);
+        vector<float> staticMax(scan->size(), -INFINITY);
+        int end = min(121, (int)scan->size());
+        for (int i = 60; i < end; i++) {
+            staticMin[i] = 0;
+            staticMax[i] = 0.215;
+        }
+        safetyZone.build(scan->beams, staticMin, staticMax);
+    }
+    int count = safetyZone.violations(scan->msg->ranges, commandLin, commandAng);
+    if (count > 2) {
+        stop(1);
+        stringstream s;
+        s << "EMERGENCY STOP, LIDAR! " << count << " beams, command " << commandLin << " " << commandAng;
+        ROS_INFO("%s/n", s.str().c_str());
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::lidarCallback(const sensor_msgs::LaserScan::ConstPtr& msg)
+{
+    scan = ScanPreprocessor::preprocess(msg);
+    angleIncrement = msg->angle_increment;
+
+    range_min = msg->range_min;
+    range_max = msg->range_max;
+
+    emergencyStopLidar();
+    updateLocalMapLidar();
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::depthCallback(const project_msgs::depth::ConstPtr& msg) {
+    // the message has no stamp, the hits are as old as their arrival
+    double now = ros::Time::now().toSec();
+    if (grid) {
+        grid->moveTo(locX, locY);
+        for (size_t i = 0; i < msg->ranges.size(); i++) {
+            double a = locTheta + msg->angles[i];
+            grid->castRay(RollingGrid::DEPTH, locX, locY,
+                          locX + msg->ranges[i]*cos(a), locY + msg->ranges[i]*sin(a), true);
+        }
+        return;
+    }
+    depthObstacles.expire(now - depthLifetime);
+    for (size_t i = 0; i < msg->ranges.size(); i++) {
+        double a = locTheta + msg->angles[i];
+        depthObstacles.add(locX + msg->ranges[i]*cos(a), locY + msg->ranges[i]*sin(a), now);
+    }
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::locationCallback(const nav_msgs::Odometry::ConstPtr& msg) {
+    locX = msg->pose.pose.position.x;
+    locY = msg->pose.pose.position.y;
+    locTheta = tf::getYaw(msg->pose.pose.orientation);
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::twistCallback(const geometry_msgs::Twist::ConstPtr& msg) {
+    commandLin = msg->linear.x;
+    commandAng = msg->angular.z;
+}
+
+template <int Bins>
+bool PolarLocalPathPlanner<Bins>::directionCallback(project_msgs::direction::Request  &req,
+                                                    project_msgs::direction::Response &res) {
+    res.angVel = amendDirection(req.linVel, req.angVel);
+    return true;
+}
+
+template <int Bins>
+bool PolarLocalPathPlanner<Bins>::directionsCallback(project_msgs::directions::Request  &req,
+                                                     project_msgs::directions::Response &res) {
+    res.angVels = amendDirections(req.linVel, req.angVels);
+    return true;
+}
+
+template <int Bins>
+double PolarLocalPathPlanner<Bins>::amendDirection(double linVel, double angVel) {
+
+    mapRad = linVel;
+    shared_ptr<const LocalMap> snapshot = atomic_load(&localMapProcessed);
+    if (!snapshot) {
+        // no scan yet
+        return angVel;
+    }
+    return amendDirection(*snapshot, angVel);
+}
+
+template <int Bins>
+vector<double> PolarLocalPathPlanner<Bins>::amendDirections(double linVel, const vector<double>& angVels) {
+
+    mapRad = linVel;
+    shared_ptr<const LocalMap> snapshot = atomic_load(&localMapProcessed);
+    if (!snapshot) {
+        return angVels;
+    }
+    vector<double> amended(angVels.size());
+    for (size_t k = 0; k < angVels.size(); k++) {
+        amended[k] = amendDirection(*snapshot, angVels[k]);
+    }
+    return amended;
+}
+
+template <int Bins>
+double PolarLocalPathPlanner<Bins>::amendDirection(const LocalMap& localMap, double angVel) {
+
+    int angleInd = round(angVel/2.0/M_PI*Bins);
+    const Heading& heading = localMap.headings[Polar::wrap(angleInd)];
+    if (heading.deviation) {
+         ROS_DEBUG_STREAM("DEVIATION FROM A PATH - ANGLE");
+         stop(4);
+    }
+    if (heading.blocked) {
+        stop(3);
+    }
+    ROS_DEBUG_STREAM("angleInd " << angleInd << ", right " << angleInd + heading.right << ", left " << angleInd + heading.left);
+    return Polar::angle(angleInd + heading.amended);
+}
+
+template <int Bins>
+void PolarLocalPathPlanner<Bins>::showLocalMap() {
+
+    //cout<< "Local Map: " ;
+    shared_ptr<const LocalMap> snapshot = atomic_load(&localMapProcessed);
+    if (!snapshot) {
+        return;
+    }
+    const vector<float>& localMapProcessed = snapshot->bins;
+    visualization_msgs::MarkerArray markers;
+    for (int i = 0; i < localMapProcessed.size(); i++) {
+        //cout << localMap[i] ;
+        if (localMapProcessed[i] > 0) {
+            visualization_msgs::Marker marker;
+            marker.header.frame_id = "/base_link";
+            marker.header.stamp = ros::Time::now();
+            marker.id = i;
+            marker.lifetime = ros::Duration(0.1);
+            marker.ns = "local_map";
+            marker.type = visualization_msgs::Marker::CYLINDER;
+            marker.action = visualization_msgs::Marker::MODIFY;
+            marker.pose.position.x = mapRad*Polar::tables().cosCentre[i];
+            marker.pose.position.y = mapRad*Polar::tables().sinCentre[i];
+            marker.pose.position.z = 0;
+            marker.pose.orientation.x = 0.0;
+            marker.pose.orientation.y = 0.0;
+            marker.pose.orientation.z = 0.0;
+            marker.pose.orientation.w = 1.0;
+            marker.scale.x = 0.05;
+            marker.scale.y = 0.05;
+            marker.scale.z = 0.1;
+            marker.color.a = 0.5;
+            marker.color.r = 1.0;
+            marker.color.g = 0.0;
+            marker.color.b = 0.0;
+            markers.markers.push_back(marker);
+        }
+    }
+    //cout << endl;
+    lppViz.publish(markers);
+}
+
+template class PolarLocalPathPlanner<360>;
+template class PolarLocalPathPlanner<720>;
+template class PolarLocalPathPlanner<1440>;
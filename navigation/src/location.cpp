@@ -13,6 +13,15 @@ Location::Location(double _xStart, double _yStart, double _thetaStart):
     x=xStart;
     y=yStart;
     theta = thetaStart;
+    publish();
+}
+
+void Location::publish() {
+    shared_ptr<Pose> snapshot = make_shared<Pose>();
+    snapshot->x = x;
+    snapshot->y = y;
+    snapshot->theta = theta;
+    atomic_store(&pose, shared_ptr<const Pose>(snapshot));
 }
 
 void Location::callback(const nav_msgs::Odometry::ConstPtr& msg)
@@ -23,6 +32,7 @@ void Location::callback(const nav_msgs::Odometry::ConstPtr& msg)
 
   geometry_msgs::Quaternion odom_quat = msg->pose.pose.orientation;
   theta = tf::getYaw(odom_quat);
+  publish();
 
   stringstream s;
   s << "Received position: " << x << " " << y << " "<< theta;
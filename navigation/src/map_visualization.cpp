@@ -54,11 +54,12 @@ void MapVisualization::loadMap() {
     grid.data.clear();
     size_t nx = gpp->gridSize.first;
     size_t ny = gpp->gridSize.second;
+    shared_ptr<const GridMap> map = gpp->map.pin();
     for (size_t j = 0; j < ny; j++) {
         for (size_t i = 0; i < nx; i++) {
 
 
-            if (gpp->map[i][j] == 0) {
+            if (map->get(i, j) == 0) {
                 grid.data.push_back(0);
             } else {
                 grid.data.push_back(255);
@@ -76,12 +77,12 @@ void MapVisualization::publishMap(int count) {
     grid_pub.publish(grid);
 }
 
-void MapVisualization::publishPath(vector<pair<double, double> >& globalPath) {
+void MapVisualization::publishPath(vector<pair<double, double> >& globalPath, size_t from) {
 
     nav_msgs::Path path;
     path.header.frame_id = "/world_map";
     path.header.stamp = ros::Time::now();
-    for (int i = 0; i < globalPath.size(); i++) {
+    for (size_t i = from; i < globalPath.size(); i++) {
         geometry_msgs::PoseStamped pose;
         //pair<int, int> cell = gpp->getCell(globalPath[i].first, globalPath[i].second);
         pose.pose.position.x = globalPath[i].first;
@@ -10,25 +10,37 @@
 #define _USE_MATH_DEFINES
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
 #include <std_msgs/Bool.h>
 #include <tf/transform_broadcaster.h>
+#include <visualization_msgs/MarkerArray.h>
 #include <sstream>
 #include <math.h>
 #include <iostream>
 #include <pwd.h>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include <location.h>
 #include <path.h>
 #include <global_path_planner.h>
 #include <map_visualization.h>
+#include <planning_executor.h>
+#include <local_path_planner.h>
+#include <trajectory_optimiser.h>
+#include <navigation_node.h>
 #include <project_msgs/stop.h>
 #include "project_msgs/direction.h"
 #include "project_msgs/global_path.h"
 #include "project_msgs/exploration.h"
 #include "project_msgs/distance.h"
+#include "project_msgs/route.h"
+#include "project_msgs/planner_diagnostics.h"
 
 using namespace std;
 
@@ -41,9 +53,14 @@ class GoalPosition {
     double angleTol;
     bool changedPosition;
     bool path_found;
-
-    GoalPosition(shared_ptr<GlobalPathPlanner> _gpp, shared_ptr<Location> _loc, shared_ptr<Path> _path);
-    void callback(double x_new, double y_new, double theta_new, double distanceTol_new, double angleTol_new);
+    // guards the goal, the path and the exploration state,
+    // shared between the control loop and the planner threads
+    timed_mutex stateMutex;
+
+    GoalPosition(shared_ptr<GlobalPathPlanner> _gpp, shared_ptr<Location> _loc, shared_ptr<Path> _path,
+                 shared_ptr<PlanningExecutor> _executor);
+    bool callback(double x_new, double y_new, double theta_new, double distanceTol_new, double angleTol_new,
+                  const atomic<bool>& cancelled);
     void publisherCallback(const geometry_msgs::Twist::ConstPtr& msg);
     bool serviceCallback(project_msgs::global_path::Request &request,
                          project_msgs::global_path::Response &response);
@@ -52,15 +69,25 @@ class GoalPosition {
                              project_msgs::exploration::Response &response);
     bool distanceServiceCallback(project_msgs::distance::Request &request,
                                  project_msgs::distance::Response &response);
+    bool routeServiceCallback(project_msgs::route::Request &request,
+                              project_msgs::route::Response &response);
+    // plans again from the current location after an emergency stop, on a planner thread;
+    // the path (or that none was found) is offered to the control loop
+    bool replan();
   private:
+    // plans the exploration path on a copy of the exploration state without the lock,
+    // puts the copy back and offers the path unless the exploration state changed meanwhile
+    void planExploration(const atomic<bool>& cancelled);
     shared_ptr<GlobalPathPlanner> gpp;
     shared_ptr<Location> loc;
     shared_ptr<Path> path;
+    shared_ptr<PlanningExecutor> executor;
 };
 
-GoalPosition::GoalPosition(shared_ptr<GlobalPathPlanner> _gpp, shared_ptr<Location> _loc, shared_ptr<Path> _path):
+GoalPosition::GoalPosition(shared_ptr<GlobalPathPlanner> _gpp, shared_ptr<Location> _loc, shared_ptr<Path> _path,
+                           shared_ptr<PlanningExecutor> _executor):
              x(0), y(0), theta(0), distanceTol(0.10), angleTol(2*M_PI), gpp(_gpp), loc(_loc), path(_path),
-             changedPosition(false) {
+             executor(_executor), changedPosition(false) {
 }
 
 void GoalPosition::publisherCallback(const geometry_msgs::Twist::ConstPtr& msg)
@@ -69,7 +96,8 @@ void GoalPosition::publisherCallback(const geometry_msgs::Twist::ConstPtr& msg)
   double y_new = msg->linear.y;
   double theta_new = msg->angular.z;
 
-  callback(x_new,y_new,theta_new, distanceTol, angleTol);
+  atomic<bool> cancelled(false);
+  callback(x_new,y_new,theta_new, distanceTol, angleTol, cancelled);
 
 }
 
@@ -82,15 +110,20 @@ bool GoalPosition::serviceCallback(project_msgs::global_path::Request &request,
   double distanceTol_new = request.distanceTol;
   double angleTol_new = request.angleTol;
 
-  callback(x_new, y_new, theta_new,distanceTol_new, angleTol_new);
-  response.path_found = path_found;
+  bool found = false;
+  bool done = executor->run(PlanningExecutor::GOAL, [&](const atomic<bool>& cancelled) {
+      found = callback(x_new, y_new, theta_new,distanceTol_new, angleTol_new, cancelled);
+  });
+  response.path_found = done && found;
 
   return true;
 
 }
 
-void GoalPosition::callback(double x_new, double y_new, double theta_new, double distanceTol_new, double angleTol_new) {
+bool GoalPosition::callback(double x_new, double y_new, double theta_new, double distanceTol_new, double angleTol_new,
+                            const atomic<bool>& cancelled) {
 
+    unique_lock<timed_mutex> lock(stateMutex);
     stringstream s;
     s << "Received the goal position: " << x_new << " " << y_new << " " << theta_new;
     ROS_INFO("%s/n", s.str().c_str());
@@ -107,27 +140,36 @@ void GoalPosition::callback(double x_new, double y_new, double theta_new, double
         changedPosition = true;
     }
 
+    shared_ptr<const Pose> pose = loc->latest();
     if (distanceTol > 10) {
-        x = loc->x;
-        y = loc->y;
+        x = pose->x;
+        y = pose->y;
     }
 
     if (changedPosition) {
         string msg = "Recalculate path";
         ROS_INFO("%s/n", msg.c_str());
-        pair<double, double> startCoord(loc->x,loc->y);
+        pair<double, double> startCoord(pose->x,pose->y);
         pair<double, double> goalCoord(x,y);
-        vector<pair<double,double> >  globalPath = gpp->getPath(startCoord, goalCoord);
+        // the search works on a pinned map, the control loop goes on meanwhile
+        lock.unlock();
+        vector<pair<double,double> >  globalPath = gpp->simplifyPath(gpp->getPath(startCoord, goalCoord));
+        lock.lock();
+        if (cancelled) {
+            string msg = "Goal request is superseded by a newer one";
+            ROS_INFO("%s/n", msg.c_str());
+            return false;
+        }
         if (globalPath.size() == 0) {
             stringstream s;
-            s << "Cant find a global path! Location " << loc->x <<" "<< loc->y;
+            s << "Cant find a global path! Location " << pose->x <<" "<< pose->y;
             ROS_INFO("%s/n", s.str().c_str());
             path_found = false;
         } else {
             stringstream s;
             s << "Path is found, size" << globalPath.size();
             ROS_INFO("%s/n", s.str().c_str());
-            path->setPath(x, y, theta, distanceTol, angleTol, globalPath);
+            path->offerPath(x, y, theta, distanceTol, angleTol, globalPath);
             changedPosition = false;
             path_found = true;
         }
@@ -136,6 +178,7 @@ void GoalPosition::callback(double x_new, double y_new, double theta_new, double
     if (gpp->explorationStatus > 0) {
         gpp->explorationStatus = 2;
     }
+    return path_found;
 }
 
 bool GoalPosition::explorationCallback(project_msgs::exploration::Request &request,
@@ -143,38 +186,146 @@ bool GoalPosition::explorationCallback(project_msgs::exploration::Request &reque
 
     ROS_INFO("Hello from exploration callback in navigation node");
     bool req = request.req;
+    bool done = true;
     if (req) {
-        stringstream s;
-        s << "Exploration path callback! "<< loc->x << " " <<loc->y;
-        ROS_INFO("%s/n", s.str().c_str());
-        gpp->explorationCallback(req, loc->x, loc->y);
-        pair<double, double> goal = gpp->explorationPath.back();
-        path->setPath(goal.first, goal.second, theta, 0.10, 2*M_PI, gpp->explorationPath);
+        done = executor->run(PlanningExecutor::EXPLORATION, [&](const atomic<bool>& cancelled) {
+            shared_ptr<const Pose> pose = loc->latest();
+            stringstream s;
+            s << "Exploration path callback! "<< pose->x << " " <<pose->y;
+            ROS_INFO("%s/n", s.str().c_str());
+            planExploration(cancelled);
+        });
     }
 
-    response.resp = true;
+    // false if the request was rejected or cancelled
+    response.resp = done;
     return true;
 }
 
+void GoalPosition::planExploration(const atomic<bool>& cancelled) {
+    unique_lock<timed_mutex> lock(stateMutex);
+    shared_ptr<const Pose> pose = loc->latest();
+    ExplorationPlan plan = gpp->explorationSnapshot();
+    int statusBefore = plan.status;
+    lock.unlock();
+
+    gpp->planExploration(plan, true, pose->x, pose->y);
+
+    lock.lock();
+    if (cancelled || gpp->explorationStatus != statusBefore) {
+        // the exploration was stopped, taken over by a goal or completed while planning
+        gpp->discardExploration(plan);
+        return;
+    }
+    gpp->applyExploration(plan);
+    if (plan.path.empty()) {
+        ROS_INFO("%s/n", "Cant find an exploration path!");
+        return;
+    }
+    pair<double, double> g = plan.path.back();
+    path->offerPath(g.first, g.second, theta, 0.10, 2*M_PI, plan.path);
+    stringstream s;
+    s << "Path is found, size, first element " << plan.path[0].first << " "<< plan.path[0].second << endl;
+    ROS_INFO("%s/n", s.str().c_str());
+}
+
 bool GoalPosition::distanceServiceCallback(project_msgs::distance::Request &request,
                                            project_msgs::distance::Response &response){
     pair<double, double> startCoord(request.startPose.linear.x, request.startPose.linear.y);
     pair<double, double> goalCoord(request.goalPose.linear.x, request.goalPose.linear.y);
-    int dist = gpp->getDistance(startCoord, goalCoord);
+    int dist = 0;
+    bool done = executor->run(PlanningExecutor::DISTANCE, [&](const atomic<bool>& cancelled) {
+        dist = gpp->getDistance(startCoord, goalCoord);
+    });
+    if (!done) {
+        // rejected or cancelled, 0 would read as a goal next to the start
+        ROS_WARN("Distance request was not served");
+        return false;
+    }
     response.distance = dist;
     return true;
 }
 
+bool GoalPosition::routeServiceCallback(project_msgs::route::Request &request,
+                                        project_msgs::route::Response &response){
+    pair<double, double> startCoord(request.startPose.linear.x, request.startPose.linear.y);
+    vector<pair<double, double> > targets;
+    for (size_t i = 0; i < request.targetPoses.size(); i++) {
+        targets.push_back(pair<double, double>(request.targetPoses[i].linear.x, request.targetPoses[i].linear.y));
+    }
+    double timeBudget = request.timeBudget > 0 ? request.timeBudget : 0.5;
+
+    vector<pair<double, double> > routePath;
+    vector<int> order;
+    // served with the distance queries
+    executor->run(PlanningExecutor::DISTANCE, [&](const atomic<bool>& cancelled) {
+        order = gpp->getRoute(startCoord, targets, timeBudget, routePath);
+    });
+
+    response.order = vector<int>(order.begin(), order.end());
+    response.path_found = order.size() > 0;
+    // metres along the stitched path
+    response.length = 0;
+    for (size_t i = 0; i < routePath.size(); i++) {
+        if (i > 0) {
+            response.length += hypot(routePath[i].first - routePath[i-1].first, routePath[i].second - routePath[i-1].second);
+        }
+        geometry_msgs::Twist pose;
+        pose.linear.x = routePath[i].first;
+        pose.linear.y = routePath[i].second;
+        response.path.push_back(pose);
+    }
+    return true;
+}
+
+bool GoalPosition::replan() {
+    PlanningExecutor::Priority priority = (gpp->explorationStatus == 1) ? PlanningExecutor::EXPLORATION
+                                                                       : PlanningExecutor::GOAL;
+    return executor->post(priority, [this](const atomic<bool>& cancelled) {
+        unique_lock<timed_mutex> lock(stateMutex);
+        shared_ptr<const Pose> pose = loc->latest();
+        if (gpp->explorationStatus == 1) {
+            lock.unlock();
+            planExploration(cancelled);
+            return;
+        }
+        string msg = "Recalculate path";
+        ROS_INFO("%s/n", msg.c_str());
+        pair<double, double> startCoord(pose->x,pose->y);
+        pair<double, double> goalCoord(x,y);
+        double goalTheta = theta;
+        double goalDistanceTol = distanceTol;
+        double goalAngleTol = angleTol;
+        lock.unlock();
+        vector<pair<double,double> >  globalPath = gpp->simplifyPath(gpp->getPath(startCoord, goalCoord));
+        if (cancelled) {
+            return;
+        }
+        if (globalPath.size() == 0) {
+            stringstream s;
+            s << "Cant find a global path! Location " << pose->x <<" "<< pose->y;
+            ROS_INFO("%s/n", s.str().c_str());
+            std_msgs::Bool status_msg;
+            status_msg.data = 0;
+            path->statusPub.publish(status_msg);
+        } else {
+            stringstream s;
+            s << "Path is found, size" << globalPath.size();
+            ROS_INFO("%s/n", s.str().c_str());
+        }
+        // an empty path is offered too, the robot goes on as it did before
+        path->offerPath(goalCoord.first, goalCoord.second, goalTheta, goalDistanceTol, goalAngleTol, globalPath);
+    });
+}
+
 string getHomeDir() {
     passwd* pw = getpwuid(getuid());
     string path(pw->pw_dir);
     return path;
 }
 
-int main(int argc, char **argv)
+void runNavigationNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running)
 {
-  ros::init(argc, argv, "navigation_node");
-  ros::NodeHandle n;
 
   // Global Path Planner
   string mapFile = getHomeDir()+"/catkin_ws/src/ras_maze/ras_maze_map/maps/lab_maze_2017.txt";
@@ -193,62 +344,174 @@ int main(int argc, char **argv)
   ros::Subscriber locationSub = n.subscribe("/odom", 1, &Location::callback, loc.get());
 
   // Map update
-  ros::Subscriber mapUpdateSub = n.subscribe("/wall_finder_walls_array", 5, &GlobalPathPlanner::newWallCallback, gpp.get());
+  // walls are added on their own thread, planners work on pinned map versions
+  ros::NodeHandle mapUpdateNh;
+  ros::CallbackQueue mapUpdateQueue;
+  mapUpdateNh.setCallbackQueue(&mapUpdateQueue);
+  ros::Subscriber mapUpdateSub = mapUpdateNh.subscribe("/wall_finder_walls_array", 5, &GlobalPathPlanner::newWallCallback, gpp.get());
+  ros::AsyncSpinner mapUpdateSpinner(1, &mapUpdateQueue);
+  mapUpdateSpinner.start();
 
   // Path
   double pathRad = 0.25;
   double distanceTol = 0.10;
   double angleTol = 2*M_PI;
   shared_ptr<Path> path = make_shared<Path>(pathRad, distanceTol, angleTol);
-  path->lppService = n.serviceClient<project_msgs::direction>("local_path");
   path->statusPub = n.advertise<std_msgs::Bool>("navigation/status", 1);
   path->stopPub = n.advertise<project_msgs::stop>("navigation/obstacles", 1);
+  // Local map
+  // sensor callbacks have their own thread, the control loop reads the latest local map
+  shared_ptr<LocalPathPlanner> lpp = make_shared<LocalPathPlanner>(0.18, pathRad);
+  if (n.param<bool>("/local_map/rolling_grid", false)) {
+    lpp->useRollingGrid();
+  }
+  ros::NodeHandle lppNh;
+  ros::CallbackQueue lppQueue;
+  lppNh.setCallbackQueue(&lppQueue);
+  ros::Subscriber lidarSub = lppNh.subscribe("/scan", 1, &LocalPathPlanner::lidarCallback, lpp.get());
+  ros::Subscriber depthSub = lppNh.subscribe("/depth", 1, &LocalPathPlanner::depthCallback, lpp.get());
+  ros::Subscriber lppLocationSub = lppNh.subscribe("/odom", 1, &LocalPathPlanner::locationCallback, lpp.get());
+  ros::Subscriber lppTwistSub = lppNh.subscribe("/motor_controller/twist", 1, &LocalPathPlanner::twistCallback, lpp.get());
+  lpp->lppViz = n.advertise<visualization_msgs::MarkerArray>("navigation/visualize_lpp", 360);
+  lpp->stopPub = n.advertise<project_msgs::stop>("navigation/obstacles", 1);
+  ros::AsyncSpinner lppSpinner(1, &lppQueue);
+  lppSpinner.start();
+  path->lpp = lpp;
+
   // emergency stop
   ros::Subscriber subObstacles = n.subscribe("navigation/obstacles", 1000, &Path::obstaclesCallback, path.get());
 
-  // Goal
-  GoalPosition goal = GoalPosition(gpp, loc, path);
-  ros::Subscriber goalSub = n.subscribe("navigation/set_the_goal_test", 1, &GoalPosition::publisherCallback, &goal);
-  ros::ServiceServer explorationService = n.advertiseService("navigation/exploration_path", &GoalPosition::explorationCallback, &goal);
-  ros::ServiceServer service = n.advertiseService("navigation/set_the_goal", &GoalPosition::serviceCallback, &goal);
-  ros::ServiceServer distanceService = n.advertiseService("navigation/distance", &GoalPosition::distanceServiceCallback, &goal);
+  // Planner requests are executed by a pool of workers
+  int plannerThreads = 2;
+  int plannerQueueSize = 8;
+  shared_ptr<PlanningExecutor> executor = make_shared<PlanningExecutor>(plannerThreads, plannerQueueSize);
+  executor->statsPub = n.advertise<std_msgs::Float32MultiArray>("navigation/planner_stats", 1);
+
+  // Planner query metrics, aggregated and published every diagnosticsPeriod seconds
+  double diagnosticsPeriod = 5.0;
+  gpp->diagnostics = make_shared<PlannerDiagnostics>();
+  gpp->diagnostics->pub = n.advertise<project_msgs::planner_diagnostics>("navigation/planner_diagnostics", 10);
+  ros::Timer diagnosticsTimer = n.createTimer(ros::Duration(diagnosticsPeriod), &PlannerDiagnostics::publish, gpp->diagnostics.get());
 
+  // Goal
+  GoalPosition goal(gpp, loc, path, executor);
+  // services have their own queue, each waiting request holds one spinner thread
+  ros::NodeHandle plannerNh;
+  ros::CallbackQueue plannerQueue;
+  plannerNh.setCallbackQueue(&plannerQueue);
+  ros::Subscriber goalSub = plannerNh.subscribe("navigation/set_the_goal_test", 1, &GoalPosition::publisherCallback, &goal);
+  ros::ServiceServer explorationService = plannerNh.advertiseService("navigation/exploration_path", &GoalPosition::explorationCallback, &goal);
+  ros::ServiceServer service = plannerNh.advertiseService("navigation/set_the_goal", &GoalPosition::serviceCallback, &goal);
+  ros::ServiceServer distanceService = plannerNh.advertiseService("navigation/distance", &GoalPosition::distanceServiceCallback, &goal);
+  ros::ServiceServer routeService = plannerNh.advertiseService("navigation/route", &GoalPosition::routeServiceCallback, &goal);
+  ros::AsyncSpinner plannerSpinner(plannerQueueSize + plannerThreads, &plannerQueue);
+  plannerSpinner.start();
+
+  // The control loop only follows the path: planning runs on the executor and the
+  // markers on a thread of their own, so a step takes well under its period.
+  double controlRate = 50;
   ros::Publisher pub = n.advertise<geometry_msgs::Twist>("/motor_controller/twist", 1);
-  ros::Rate loop_rate(10);
+  ros::Rate loop_rate(controlRate);
+
+  // total velocity, the cap stays until it is tuned again on the robot
+  double maxVelocity = 0.18;
+
+  // velocities from arcs scored over the local map instead of the fixed shaping below
+  shared_ptr<TrajectoryOptimiser> optimiser;
+  if (n.param<bool>("/navigation/trajectory_optimiser", false)) {
+    TrajectoryLimits limits;
+    limits.period = 1.0/controlRate;
+    limits.maxLin = maxVelocity;
+    optimiser = make_shared<TrajectoryOptimiser>(0.18, limits);
+  }
+  // the last command sent, where the next one starts from
+  double sentLinVel = 0;
+  double sentAngVel = 0;
+  shared_ptr<const geometry_msgs::Twist> sentTwist = make_shared<geometry_msgs::Twist>();
+
+  // markers at 10 Hz, skipped while a planner holds the state
+  atomic<bool> vizRunning(true);
+  thread vizThread([&]() {
+    ros::WallRate vizRate(10);
+    int count = 0;
+    while (vizRunning) {
+      // the occupancy grid is built from a pinned map and needs no lock
+      if (count % 10 == 0) {
+        mapViz.publishMap(count);
+      }
+      {
+        unique_lock<timed_mutex> lock(goal.stateMutex, try_to_lock);
+        if (lock.owns_lock()) {
+          mapViz.publishNodes();
+          mapViz.publishPath(gpp->explorationPath, gpp->explorationProgress);
+        }
+      }
+      shared_ptr<const geometry_msgs::Twist> twist = atomic_load(&sentTwist);
+      mapViz.publishDirection(twist->linear.x, twist->angular.z);
+      lpp->showLocalMap();
+      vizRate.sleep();
+      ++count;
+    }
+  });
 
+  // the velocities of the last 1.5 s
   vector<pair<double, double> > history;
-  int maxHistorySize = 15;
+  int maxHistorySize = 75;
 
   path->onlyTurn = false;
   double prevAngVel = 0.0;
 
+  // steps in a row without the state, after 0.1 s of them the robot is stopped
+  int missedSteps = 0;
+  int maxMissedSteps = controlRate/10;
+
   // recovery
   std_msgs::Bool status_msg;
   status_msg.data = 0;
   path->statusPub.publish(status_msg);
   gpp->explorationStatusPub.publish(status_msg);
 
-  int count = 0;
-  while (ros::ok())
+  while (ros::ok() && running)
   {
 
+    unique_lock<timed_mutex> lock(goal.stateMutex, chrono::milliseconds(5));
+    if (!lock.owns_lock()) {
+        // the state is held for a moment (a goal coming in, a plan being applied,
+        // the markers), the last command is sent again
+        geometry_msgs::Twist msg;
+        if (++missedSteps <= maxMissedSteps) {
+            msg = *atomic_load(&sentTwist);
+        }
+        pub.publish(msg);
+        sentLinVel = msg.linear.x;
+        sentAngVel = msg.angular.z;
+        atomic_store(&sentTwist, shared_ptr<const geometry_msgs::Twist>(make_shared<geometry_msgs::Twist>(msg)));
+        queue.callAvailable();
+        loop_rate.sleep();
+        continue;
+    }
+    missedSteps = 0;
+
+    // a path planned since the last step
+    path->takeOffer();
+    shared_ptr<const Pose> pose = loc->latest();
+
     path->linVel = 0;
     path->angVel = 0;
 
-    cout << "STATES: "<< path->move << " " << path->rollback << " " << path->replan << " "<< gpp->explorationStatus <<endl;
+    // every step, so only at debug level
+    ROS_DEBUG_STREAM("STATES: "<< path->move << " " << path->rollback << " " << path->replan << " "<< gpp->explorationStatus);
 
     if (path->move) {
 
         if (gpp->explorationStatus == 1) {
-            gpp->explorationUpdate(loc->x,loc->y,loc->theta, path->globalPath.size());
+            gpp->explorationUpdate(pose->x,pose->y,pose->theta, path->globalPath.cursorIndex());
         }
 
-        path->followPath(loc->x,loc->y,loc->theta);
-        stringstream s;
-        s << "Follow path " << path->linVel << " " << path->angVel << ", Location " << loc->x << " " << loc->y << " " << loc->theta;
-        ROS_INFO("%s/n", s.str().c_str());
+        path->followPath(pose->x,pose->y,pose->theta);
+        ROS_DEBUG_STREAM("Follow path " << path->linVel << " " << path->angVel << ", Location " << pose->x << " " << pose->y << " " << pose->theta);
 
-        if (path->globalPath.size()==0 && gpp->explorationStatus ==1 ) {
+        if (path->globalPath.empty() && gpp->explorationStatus ==1 ) {
             // Exploration Completed
             gpp->explorationStatus = 3;
             std_msgs::Bool msg;
@@ -262,17 +525,28 @@ int main(int argc, char **argv)
         }
         prevAngVel = path->angVel;
         if (path->onlyTurn) {
-            cout << "Only turning!" << endl;
+            ROS_DEBUG_STREAM("Only turning!");
         }
 
-        double c = 0.18; // total velocity
+        double c = maxVelocity; // total velocity
         double r = 0.12; // approximate radius of wheel base
         double k = max(1.0, 25*pow(fabs(path->angVel),2));
+        shared_ptr<const ObstaclePoints> obstacles = optimiser ? lpp->obstaclePoints() : shared_ptr<const ObstaclePoints>();
         // maybe check abs(path->directionChange) > 0.1
         if (fabs(path->angVel) > M_PI/2.0 || path->onlyTurn) {
             path->linVel = 0; // sharp turn
         }
-        if (path->linVel > 0) {
+        if (obstacles && path->move && !path->onlyTurn && path->linVel > 0) {
+            // target in base_link
+            double dx = path->targetX - pose->x;
+            double dy = path->targetY - pose->y;
+            double targetX = cos(pose->theta)*dx + sin(pose->theta)*dy;
+            double targetY = cos(pose->theta)*dy - sin(pose->theta)*dx;
+            pair<double,double> command = optimiser->plan(obstacles->x, obstacles->y, targetX, targetY,
+                                                          !path->globalPath.empty(), sentLinVel, sentAngVel);
+            path->linVel = command.first;
+            path->angVel = command.second;
+        } else if (path->linVel > 0) {
             double a = c/(r*fabs(path->angVel)+ fabs(path->linVel)/k);
             path->linVel = a/k*path->linVel;
             path->angVel = a*path->angVel;
@@ -306,35 +580,11 @@ int main(int argc, char **argv)
             }
         //}
     } else if (path->replan) {
-        if (gpp->explorationStatus == 1 ) {
-            gpp->explorationCallback(true, loc->x, loc->y);
-            pair<double, double> g = gpp->explorationPath[gpp->explorationPath.size()-1];
-            path->setPath(g.first, g.second, goal.theta, distanceTol, angleTol, gpp->explorationPath);
-            stringstream s;
-            s << "Path is found, size, first element " << path->globalPath[0].first << " "<< path->globalPath[0].second << endl;
-            ROS_INFO("%s/n", s.str().c_str());
-        } else {
-            string msg = "Recalculate path";
-            ROS_INFO("%s/n", msg.c_str());
-            pair<double, double> startCoord(loc->x,loc->y);
-            pair<double, double> goalCoord(goal.x,goal.y);
-            vector<pair<double,double> >  globalPath = gpp->getPath(startCoord, goalCoord);
-            if (globalPath.size() == 0) {
-                stringstream s;
-                s << "Cant find a global path! Location " << loc->x <<" "<< loc->y;
-                ROS_INFO("%s/n", s.str().c_str());
-                std_msgs::Bool status_msg;
-                status_msg.data = 0;
-                path->statusPub.publish(status_msg);
-            } else {
-                stringstream s;
-                s << "Path is found, size" << globalPath.size();
-                ROS_INFO("%s/n", s.str().c_str());
-                path->setPath(goal.x, goal.y, goal.theta, goal.distanceTol, goal.angleTol, globalPath);
-            }
-        }
+        // the robot waits until the planner offers the new path
         path->replan = false;
-        path->move = true;
+        if (!goal.replan()) {
+            path->move = true;
+        }
     }
 
     // precaution (if emergency stop appeared while doing computations)
@@ -360,20 +610,19 @@ int main(int argc, char **argv)
 
     //ROS_INFO("%s", msg.data.c_str());
     pub.publish(msg);
+    sentLinVel = msg.linear.x;
+    sentAngVel = msg.angular.z;
+    atomic_store(&sentTwist, shared_ptr<const geometry_msgs::Twist>(make_shared<geometry_msgs::Twist>(msg)));
 
-    if (count % 10 == 0) {
-        mapViz.publishMap(count);
-    }
-    mapViz.publishNodes();
-    mapViz.publishPath(gpp->explorationPath);
-    //mapViz.publishPath(path->globalPath);
-    mapViz.publishDirection(path->linVel,path->angVel);
-    ros::spinOnce();
+    lock.unlock();
+    queue.callAvailable();
     loop_rate.sleep();
-    ++count;
   }
 
-  return 0;
+  vizRunning = false;
+  vizThread.join();
+  // the planner jobs refer to the goal, finish them first
+  executor->shutdown();
 }
 
 
@@ -0,0 +1,16 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <atomic>
+
+#include <navigation_node.h>
+
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "navigation_node");
+
+    ros::NodeHandle n;
+    std::atomic<bool> running(true);
+    runNavigationNode(n, *ros::getGlobalCallbackQueue(), running);
+
+    return 0;
+}
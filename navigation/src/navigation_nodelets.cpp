@@ -0,0 +1,71 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <atomic>
+#include <thread>
+
+#include <navigation_node.h>
+#include <local_map_node.h>
+
+namespace navigation {
+
+// navigation_node in a nodelet manager. The control loop runs on a thread of
+// its own and serves the callbacks of n from a private queue, the planner,
+// map update and local map spinners are started by the node itself.
+class NavigationNodelet : public nodelet::Nodelet {
+public:
+    NavigationNodelet(): running(false) {};
+    ~NavigationNodelet() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+private:
+    ros::CallbackQueue queue;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    virtual void onInit() {
+        ros::NodeHandle n = getNodeHandle();
+        n.setCallbackQueue(&queue);
+        running = true;
+        worker = std::thread([this, n]() mutable {
+            runNavigationNode(n, queue, running);
+        });
+    }
+};
+
+// local_map_node in a nodelet manager. navigation_node has the local map
+// built in, this one is for the clients of the local_path service.
+class LocalMapNodelet : public nodelet::Nodelet {
+public:
+    LocalMapNodelet(): running(false) {};
+    ~LocalMapNodelet() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+private:
+    ros::CallbackQueue queue;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    virtual void onInit() {
+        ros::NodeHandle n = getNodeHandle();
+        n.setCallbackQueue(&queue);
+        running = true;
+        worker = std::thread([this, n]() mutable {
+            runLocalMapNode(n, queue, running);
+        });
+    }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(navigation::NavigationNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(navigation::LocalMapNodelet, nodelet::Nodelet)
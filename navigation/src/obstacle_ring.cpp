@@ -0,0 +1,73 @@
+#include <vector>
+#include <math.h>
+
+#include <obstacle_ring.h>
+
+using namespace std;
+
+ObstacleRing::ObstacleRing(size_t p_capacity):
+    capacity(p_capacity),
+    first(0),
+    count(0),
+    xs(p_capacity, 0),
+    ys(p_capacity, 0),
+    stamps(p_capacity, 0) {
+}
+
+void ObstacleRing::add(float x, float y, double stamp) {
+    size_t i = (first + count) % capacity;
+    xs[i] = x;
+    ys[i] = y;
+    stamps[i] = stamp;
+    if (count < capacity) {
+        count++;
+    } else {
+        first = (first + 1) % capacity;
+    }
+}
+
+void ObstacleRing::expire(double before) {
+    // the points come in stamp order, the expired ones are at the front
+    while (count > 0 && stamps[first] < before) {
+        first = (first + 1) % capacity;
+        count--;
+    }
+}
+
+void ObstacleRing::project(double x, double y, double theta, vector<float>& ranges, vector<float>& angles) const {
+    if (count == 0) {
+        return;
+    }
+    if (ranges.size() < count) {
+        ranges.resize(capacity);
+        angles.resize(capacity);
+    }
+    float c = cos(theta);
+    float s = sin(theta);
+    // the live points are at most two contiguous spans of the arrays
+    size_t end = first + count;
+    if (end <= capacity) {
+        projectSpan(first, end, 0, x, y, c, s, ranges, angles);
+    } else {
+        projectSpan(first, capacity, 0, x, y, c, s, ranges, angles);
+        projectSpan(0, end - capacity, capacity - first, x, y, c, s, ranges, angles);
+    }
+}
+
+void ObstacleRing::projectSpan(size_t from, size_t to, size_t out, float x, float y, float c, float s,
+                               vector<float>& ranges, vector<float>& angles) const {
+    const float* px = &xs[0];
+    const float* py = &ys[0];
+    float* r = &ranges[out];
+    float* a = &angles[out];
+    size_t n = to - from;
+    // one branch-free pass over the arrays, rotated into the robot frame
+    for (size_t k = 0; k < n; k++) {
+        float dx = px[from + k] - x;
+        float dy = py[from + k] - y;
+        float fx = c*dx + s*dy;
+        float fy = c*dy - s*dx;
+        r[k] = sqrt(fx*fx + fy*fy);
+        a[k] = atan2(fy, fx);
+    }
+}
@@ -15,7 +15,7 @@
 using namespace std;
 
 void Path::setPath(double x, double y, double theta, double p_distanceTol, double p_angleTol, vector<pair<double,double> > path) {
-    globalPath = path;
+    globalPath = WaypointPath(path);
     setGoal(x, y, theta);
     pair<double,double> pathEnd = path[path.size()-1];
     pair<double,double> goal = pair<double, double>(x,y);
@@ -25,6 +25,31 @@ void Path::setPath(double x, double y, double theta, double p_distanceTol, doubl
     move = true;
 }
 
+void Path::offerPath(double x, double y, double theta, double p_distanceTol, double p_angleTol,
+                     const vector<pair<double,double> >& path, bool found) {
+    shared_ptr<PathOffer> next = make_shared<PathOffer>();
+    next->found = found && !path.empty();
+    next->x = x;
+    next->y = y;
+    next->theta = theta;
+    next->distanceTol = p_distanceTol;
+    next->angleTol = p_angleTol;
+    next->points = path;
+    atomic_store(&offer, shared_ptr<const PathOffer>(next));
+}
+
+bool Path::takeOffer() {
+    shared_ptr<const PathOffer> taken = atomic_exchange(&offer, shared_ptr<const PathOffer>());
+    if (!taken) {
+        return false;
+    }
+    if (taken->found) {
+        setPath(taken->x, taken->y, taken->theta, taken->distanceTol, taken->angleTol, taken->points);
+    }
+    move = true;
+    return true;
+}
+
 void Path::setGoal(double x, double y, double theta) {
     goalX = x;
     goalY = y;
@@ -85,29 +110,28 @@ void Path::followPath(double x, double y, double theta) {
     directionChange = 0;
     double targetAng = goalAng;
 
-    //cout << "Global path size = " << globalPath.size()<< endl;
-    //cout << "Global path first el = "<< globalPath[0].first << " " << globalPath[0].second << endl;
-    while (globalPath.size() > 1 &&
-               (distance(globalPath[0],loc) < pathRad ||
-                distance(globalPath[1], loc) < distance(globalPath[0], loc))
-           ) {
-        globalPath.erase(globalPath.begin());
+    // the robot is projected on the path near the last projection,
+    // it heads to the carrot point pathRad further along the path
+    if (!globalPath.empty()) {
+        globalPath.advance(x, y, 2*pathRad);
     }
-    //cout << "Global path size after reduction= " << globalPath.size()<< endl;
-    //cout << "Path rad "<< pathRad << endl;
-    //cout << "Global path first el = "<< globalPath[0].first << " " << globalPath[0].second << endl;
-    if (globalPath.size() > 1 ||
-        (globalPath.size()==1 && distance(globalPath[0],loc) >= pathRad)) {
-        linVel = distance(globalPath[0],loc);
+    //cout << "Path progress = " << globalPath.arcLength() << " of " << globalPath.length() << endl;
+    pair<double,double> pathEnd = globalPath.empty() ? goal : globalPath.back();
+    if (!globalPath.empty() &&
+        (globalPath.remainingLength() > pathRad || distance(pathEnd,loc) >= pathRad)) {
+        pair<double,double> carrot = globalPath.carrot(pathRad);
+        linVel = distance(carrot,loc);
         //cout << "LIN VEL = " << linVel << endl;
-        cout << x << " "<< y<< endl;
+        ROS_DEBUG_STREAM("Location " << x << " "<< y);
         if (linVel > 1.4*pathRad) {
             move = false;
             stop();
             return;
         }
-        targetAng = getAngle(globalPath[0],loc);
+        targetAng = getAngle(carrot,loc);
         angVel = diffAngles(targetAng, theta);
+        targetX = carrot.first;
+        targetY = carrot.second;
         amendDirection();
 
     } else {
@@ -129,15 +153,14 @@ void Path::followPath(double x, double y, double theta) {
         } else {
             targetAng = getAngle(goal,loc);
             angVel = diffAngles(targetAng, theta);
+            targetX = goalX;
+            targetY = goalY;
             amendDirection();
         }
 
     }
 
-    stringstream s;
-    s << "Tolerance " << distanceTol << " " << angleTol << endl;
-    s << "Angles " << targetAng <<" "<< theta << " " << angVel;
-    ROS_INFO("%s/n", s.str().c_str());
+    ROS_DEBUG_STREAM("Tolerance " << distanceTol << " " << angleTol << ", Angles " << targetAng <<" "<< theta << " " << angVel);
 }
 
 void Path::obstaclesCallback(const project_msgs::stop::ConstPtr& msg) {
@@ -169,14 +192,11 @@ void Path::stop() {
 }
 
 void Path::amendDirection() {
-    project_msgs::direction srv;
-    srv.request.linVel = linVel;
-    srv.request.angVel = angVel;
-    if (lppService.call(srv)) {
-        cout << "Direction changed from " << angVel;
-        angVel = srv.response.angVel;
-        cout << "  to " << angVel << endl;
-        directionChange = srv.request.angVel - srv.response.angVel;
+    if (lpp) {
+        double amended = lpp->amendDirection(linVel, angVel);
+        ROS_DEBUG_STREAM("Direction changed from " << angVel << "  to " << amended);
+        directionChange = angVel - amended;
+        angVel = amended;
     }
 }
 
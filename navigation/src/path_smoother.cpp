@@ -0,0 +1,226 @@
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+#include <path_smoother.h>
+
+using namespace std;
+
+// distance from p to the segment a-b
+static double segmentDistance(const pair<double,double>& p, const pair<double,double>& a, const pair<double,double>& b) {
+    double dx = b.first - a.first;
+    double dy = b.second - a.second;
+    double length2 = dx*dx + dy*dy;
+    double t = 0;
+    if (length2 > 0) {
+        t = ((p.first - a.first)*dx + (p.second - a.second)*dy)/length2;
+        t = min(1.0, max(0.0, t));
+    }
+    return hypot(p.first - a.first - t*dx, p.second - a.second - t*dy);
+}
+
+bool PathSmoother::isFree(const GridMap& grid, int i, int j, const SkeletonRoadmap* clearance, double margin) const {
+    if (i < 0 || j < 0 || i >= (int)grid.nx || j >= (int)grid.ny || grid.get(i, j) != 0) {
+        return false;
+    }
+    return clearance == 0 || margin <= 0 || clearance->clearance(i, j) >= margin;
+}
+
+bool PathSmoother::lineOfSight(const GridMap& grid, pair<double,double> a, pair<double,double> b,
+                               const SkeletonRoadmap* clearance) const {
+    // walks the cells crossed by the segment (Amanatides-Woo),
+    // where it passes exactly through a corner both cells beside it have to be free
+    int i = floor(a.first);
+    int j = floor(a.second);
+    int endI = floor(b.first);
+    int endJ = floor(b.second);
+    double dx = b.first - a.first;
+    double dy = b.second - a.second;
+    int stepI = (dx > 0) ? 1 : -1;
+    int stepJ = (dy > 0) ? 1 : -1;
+    double inf = numeric_limits<double>::infinity();
+    double deltaX = (dx != 0) ? 1/fabs(dx) : inf;
+    double deltaY = (dy != 0) ? 1/fabs(dy) : inf;
+    double maxX = (dx != 0) ? ((dx > 0) ? (i + 1 - a.first) : (a.first - i))*deltaX : inf;
+    double maxY = (dy != 0) ? ((dy > 0) ? (j + 1 - a.second) : (a.second - j))*deltaY : inf;
+    if (!isFree(grid, i, j, 0, 0) || !isFree(grid, endI, endJ, 0, 0)) {
+        return false;
+    }
+    // the segment keeps minClearance, a path that already runs closer at an end
+    // (a start by the wall, a grid path along the inflated obstacles) only keeps that much,
+    // so the skeleton paths are not pulled to the obstacles
+    double margin = 0;
+    if (clearance != 0 && minClearance > 0) {
+        margin = min(minClearance, min(clearance->clearance(i, j), clearance->clearance(endI, endJ)));
+    }
+
+    while (true) {
+        if (!isFree(grid, i, j, clearance, margin)) {
+            return false;
+        }
+        if ((i == endI && j == endJ) || min(maxX, maxY) > 1) {
+            break;
+        }
+        if (fabs(maxX - maxY) < 1e-9) {
+            if (!isFree(grid, i + stepI, j, clearance, margin) || !isFree(grid, i, j + stepJ, clearance, margin)) {
+                return false;
+            }
+            i += stepI;
+            j += stepJ;
+            maxX += deltaX;
+            maxY += deltaY;
+        } else if (maxX < maxY) {
+            i += stepI;
+            maxX += deltaX;
+        } else {
+            j += stepJ;
+            maxY += deltaY;
+        }
+    }
+    return isFree(grid, endI, endJ, clearance, margin);
+}
+
+vector<pair<double,double> > PathSmoother::decimate(const GridMap& grid, const vector<pair<double,double> >& points,
+                                                    const SkeletonRoadmap* clearance) const {
+    // a chord replaces the points between its ends if they are within tolerance
+    // of it and it is free, otherwise it is split at the furthest point
+    vector<bool> keep(points.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+    vector<pair<size_t,size_t> > stack(1, pair<size_t,size_t>(0, points.size() - 1));
+    while (!stack.empty()) {
+        size_t first = stack.back().first;
+        size_t last = stack.back().second;
+        stack.pop_back();
+        if (last - first < 2) {
+            continue;
+        }
+        double maxDeviation = 0;
+        size_t split = (first + last)/2;
+        for (size_t k = first + 1; k < last; k++) {
+            double deviation = segmentDistance(points[k], points[first], points[last]);
+            if (deviation > maxDeviation) {
+                maxDeviation = deviation;
+                split = k;
+            }
+        }
+        if (maxDeviation > tolerance || !lineOfSight(grid, points[first], points[last], clearance)) {
+            keep[split] = true;
+            stack.push_back(pair<size_t,size_t>(first, split));
+            stack.push_back(pair<size_t,size_t>(split, last));
+        }
+    }
+    vector<pair<double,double> > decimated;
+    for (size_t k = 0; k < points.size(); k++) {
+        if (keep[k]) {
+            decimated.push_back(points[k]);
+        }
+    }
+    return decimated;
+}
+
+vector<pair<double,double> > PathSmoother::shortcut(const GridMap& grid, const vector<pair<double,double> >& points,
+                                                    const SkeletonRoadmap* clearance) const {
+    // from every point go straight to the furthest point in sight
+    vector<pair<double,double> > shortened(1, points.front());
+    size_t i = 0;
+    while (i + 1 < points.size()) {
+        size_t j = points.size() - 1;
+        while (j > i + 1 && !lineOfSight(grid, points[i], points[j], clearance)) {
+            j--;
+        }
+        shortened.push_back(points[j]);
+        i = j;
+    }
+    return shortened;
+}
+
+vector<pair<double,double> > PathSmoother::roundCorners(const GridMap& grid, const vector<pair<double,double> >& points,
+                                                        const SkeletonRoadmap* clearance) const {
+    if (turnRadius <= 0 || points.size() < 3) {
+        return points;
+    }
+    vector<pair<double,double> > rounded(1, points.front());
+    for (size_t b = 1; b + 1 < points.size(); b++) {
+        const pair<double,double>& p0 = points[b-1];
+        const pair<double,double>& p1 = points[b];
+        const pair<double,double>& p2 = points[b+1];
+        double l1 = hypot(p1.first - p0.first, p1.second - p0.second);
+        double l2 = hypot(p2.first - p1.first, p2.second - p1.second);
+        if (l1 == 0 || l2 == 0) {
+            rounded.push_back(p1);
+            continue;
+        }
+        double u1x = (p1.first - p0.first)/l1;
+        double u1y = (p1.second - p0.second)/l1;
+        double u2x = (p2.first - p1.first)/l2;
+        double u2y = (p2.second - p1.second)/l2;
+        double turn = acos(min(1.0, max(-1.0, u1x*u2x + u1y*u2y)));
+        if (turn < 1e-3 || turn > M_PI - 1e-3) {
+            rounded.push_back(p1);
+            continue;
+        }
+        // the arc touches both legs, it takes half of a leg at most,
+        // so the radius shrinks where the legs are short
+        double side = (u1x*u2y - u1y*u2x > 0) ? 1 : -1;
+        double cut = min(turnRadius*tan(turn/2), min(l1, l2)/2);
+        double radius = cut/tan(turn/2);
+        double cx = p1.first - u1x*cut - side*u1y*radius;
+        double cy = p1.second - u1y*cut + side*u1x*radius;
+        double startAngle = atan2(p1.second - u1y*cut - cy, p1.first - u1x*cut - cx);
+        int steps = max(1, (int)ceil(turn/arcStep));
+        vector<pair<double,double> > arc;
+        bool inSight = true;
+        for (int s = 0; s <= steps && inSight; s++) {
+            double angle = startAngle + side*turn*s/steps;
+            arc.push_back(pair<double,double>(cx + radius*cos(angle), cy + radius*sin(angle)));
+            if (s > 0) {
+                inSight = lineOfSight(grid, arc[s-1], arc[s], clearance);
+            }
+        }
+        if (inSight) {
+            rounded.insert(rounded.end(), arc.begin(), arc.end());
+        } else {
+            rounded.push_back(p1);
+        }
+    }
+    rounded.push_back(points.back());
+    return rounded;
+}
+
+vector<pair<double,double> > PathSmoother::simplify(const GridMap& grid, const vector<pair<int,int> >& cells,
+                                                    const SkeletonRoadmap* clearance) const {
+    vector<pair<double,double> > points;
+    for (size_t k = 0; k < cells.size(); k++) {
+        points.push_back(pair<double,double>(cells[k].first + 0.5, cells[k].second + 0.5));
+    }
+    if (points.size() < 3) {
+        return points;
+    }
+
+    // a start or goal moved out of an obstacle is joined to the free part as it is
+    size_t first = 0;
+    while (first < cells.size() && !isFree(grid, cells[first].first, cells[first].second, 0, 0)) {
+        first++;
+    }
+    size_t last = cells.size() - 1;
+    while (last > first && !isFree(grid, cells[last].first, cells[last].second, 0, 0)) {
+        last--;
+    }
+    if (first >= last) {
+        return points;
+    }
+
+    vector<pair<double,double> > middle(points.begin() + first, points.begin() + last + 1);
+    middle = roundCorners(grid, shortcut(grid, decimate(grid, middle, clearance), clearance), clearance);
+    vector<pair<double,double> > simplified;
+    if (first > 0) {
+        simplified.push_back(points.front());
+    }
+    simplified.insert(simplified.end(), middle.begin(), middle.end());
+    if (last + 1 < points.size()) {
+        simplified.push_back(points.back());
+    }
+    return simplified;
+}
@@ -0,0 +1,400 @@
+/*
+ *  planner_benchmark.cpp
+ *
+ *  Offline benchmark of the global path planner, runs without the ROS stack.
+ *  Loads the lab maze and generated mazes of increasing size and wall density,
+ *  runs seeded random start/goal batches through getPath, getDistance and the
+ *  exploration path, reports latency percentiles, nodes expanded, memory and
+ *  path length as a table, CSV and JSON.
+ *
+ *  rosrun navigation planner_benchmark [--map FILE] [--queries N] [--seed S]
+ *      [--max-size CELLS] [--no-roadmap] [--csv FILE] [--json FILE]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/resource.h>
+#include <ros/ros.h>
+
+#include <global_path_planner.h>
+#include <search_stats.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Maze {
+    string name;
+    string file;
+    double density;   // share of the inner walls kept, 1 - perfect maze
+    bool exploration;
+};
+
+struct Result {
+    string maze;
+    string query;
+    double size;
+    double density;
+    size_t failures;
+    vector<double> latency;     // ms
+    vector<double> expansions;
+    vector<double> heapPeak;
+    vector<double> length;      // m
+    size_t mapMemory;           // kB
+
+    Result(): size(0), density(0), failures(0), mapMemory(0) {};
+};
+
+static string getHomeDir() {
+    passwd* pw = getpwuid(getuid());
+    string path(pw->pw_dir);
+    return path;
+}
+
+// kB, the maximum of the whole process since it started
+static long peakMemory() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static double percentile(vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    sort(values.begin(), values.end());
+    return values[round(p*(values.size()-1))];
+}
+
+static double mean(const vector<double>& values) {
+    if (values.empty()) {
+        return 0;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        sum += values[i];
+    }
+    return sum/values.size();
+}
+
+static double maximum(const vector<double>& values) {
+    return values.empty() ? 0 : *max_element(values.begin(), values.end());
+}
+
+/* Maze generator */
+// depth first maze on a size x size lattice of cellSize cells,
+// then every inner wall is removed with probability 1 - density (loops, open areas)
+// walls are written as "x1 y1 x2 y2" lines, as in the map files
+static void writeMaze(const string& file, int size, double cellSize, double density, unsigned int seed) {
+
+    mt19937 generator(seed);
+    // east[i][j] - wall between (i,j) and (i+1,j), north[i][j] - between (i,j) and (i,j+1)
+    vector<vector<char> > east(size, vector<char>(size, 1));
+    vector<vector<char> > north(size, vector<char>(size, 1));
+    vector<vector<char> > visited(size, vector<char>(size, 0));
+    vector<pair<int,int> > stack(1, pair<int,int>(0, 0));
+    visited[0][0] = 1;
+    while (!stack.empty()) {
+        pair<int,int> cell = stack.back();
+        int i = cell.first;
+        int j = cell.second;
+        vector<int> moves;
+        if (i > 0 && !visited[i-1][j]) moves.push_back(0);
+        if (i < size-1 && !visited[i+1][j]) moves.push_back(1);
+        if (j > 0 && !visited[i][j-1]) moves.push_back(2);
+        if (j < size-1 && !visited[i][j+1]) moves.push_back(3);
+        if (moves.empty()) {
+            stack.pop_back();
+            continue;
+        }
+        int move = moves[uniform_int_distribution<int>(0, moves.size()-1)(generator)];
+        if (move == 0) { east[i-1][j] = 0; i--; }
+        if (move == 1) { east[i][j] = 0; i++; }
+        if (move == 2) { north[i][j-1] = 0; j--; }
+        if (move == 3) { north[i][j] = 0; j++; }
+        visited[i][j] = 1;
+        stack.push_back(pair<int,int>(i, j));
+    }
+
+    uniform_real_distribution<double> uniform(0, 1);
+    ofstream out(file.c_str());
+    double side = size*cellSize;
+    out << "# generated maze " << size << "x" << size << " density " << density << " seed " << seed << endl;
+    out << 0 << " " << 0 << " " << 0 << " " << side << endl;
+    out << 0 << " " << side << " " << side << " " << side << endl;
+    out << side << " " << side << " " << side << " " << 0 << endl;
+    out << side << " " << 0 << " " << 0 << " " << 0 << endl;
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            if (i < size-1 && east[i][j] && uniform(generator) < density) {
+                out << (i+1)*cellSize << " " << j*cellSize << " " << (i+1)*cellSize << " " << (j+1)*cellSize << endl;
+            }
+            if (j < size-1 && north[i][j] && uniform(generator) < density) {
+                out << i*cellSize << " " << (j+1)*cellSize << " " << (i+1)*cellSize << " " << (j+1)*cellSize << endl;
+            }
+        }
+    }
+}
+
+static pair<double,double> randomFreePoint(GlobalPathPlanner& gpp, const GridMap& grid, mt19937& generator) {
+    uniform_int_distribution<int> x(0, gpp.gridSize.first-1);
+    uniform_int_distribution<int> y(0, gpp.gridSize.second-1);
+    for (int attempt = 0; attempt < 10000; attempt++) {
+        int i = x(generator);
+        int j = y(generator);
+        if (grid.get(i, j) == 0) {
+            return pair<double,double>(gpp.mapOffset.first+(i+0.5)*gpp.cellSize, gpp.mapOffset.second+(j+0.5)*gpp.cellSize);
+        }
+    }
+    return pair<double,double>(gpp.mapOffset.first, gpp.mapOffset.second);
+}
+
+static void record(Result& result, double latency, bool found, double length) {
+    SearchStats& stats = searchStats();
+    result.latency.push_back(latency);
+    result.expansions.push_back(stats.expansions);
+    result.heapPeak.push_back(stats.heapPeak);
+    if (found) {
+        result.length.push_back(length);
+    } else {
+        result.failures++;
+    }
+}
+
+static vector<Result> benchmarkMaze(const Maze& maze, int queries, unsigned int seed, bool useRoadmap) {
+
+    double gridCellSize = 0.01;
+    double robotRadius = 0.17;
+    // nodes left by the previous maze would be recovered as an exploration in progress
+    unlink("navigation_nodes.txt");
+    Clock::time_point t0 = Clock::now();
+    GlobalPathPlanner gpp(maze.file, gridCellSize, robotRadius);
+    chrono::duration<double, milli> loadTime = Clock::now() - t0;
+    gpp.useRoadmap = useRoadmap;
+    shared_ptr<const GridMap> grid = gpp.map.pin();
+
+    vector<Result> results(4);
+    const char* names[4] = {"load", "getPath", "getDistance", "exploration"};
+    for (size_t r = 0; r < results.size(); r++) {
+        results[r].maze = maze.name;
+        results[r].query = names[r];
+        results[r].size = gpp.mapScale.first;
+        results[r].density = maze.density;
+        results[r].mapMemory = grid->memoryUsage()/1024;
+    }
+    results[0].latency.push_back(loadTime.count());
+    results[0].expansions.push_back(0);
+    results[0].heapPeak.push_back(0);
+
+    mt19937 generator(seed);
+    for (int q = 0; q < queries; q++) {
+        pair<double,double> start = randomFreePoint(gpp, *grid, generator);
+        pair<double,double> goal = randomFreePoint(gpp, *grid, generator);
+
+        searchStats() = SearchStats();
+        t0 = Clock::now();
+        vector<pair<double,double> > path = gpp.getPath(start, goal);
+        chrono::duration<double, milli> elapsed = Clock::now() - t0;
+        double length = 0;
+        for (size_t i = 1; i < path.size(); i++) {
+            length += hypot(path[i].first - path[i-1].first, path[i].second - path[i-1].second);
+        }
+        record(results[1], elapsed.count(), !path.empty(), length);
+
+        searchStats() = SearchStats();
+        t0 = Clock::now();
+        int distance = gpp.getDistance(start, goal);
+        elapsed = Clock::now() - t0;
+        record(results[2], elapsed.count(), distance > 0, distance*gridCellSize);
+    }
+
+    if (maze.exploration) {
+        pair<double,double> start = randomFreePoint(gpp, *grid, generator);
+        searchStats() = SearchStats();
+        t0 = Clock::now();
+        gpp.explorationCallback(true, start.first, start.second);
+        chrono::duration<double, milli> elapsed = Clock::now() - t0;
+        record(results[3], elapsed.count(), !gpp.explorationPath.empty(), gpp.explorationPath.size()*gridCellSize);
+    } else {
+        results.pop_back();
+    }
+
+    return results;
+}
+
+static void printTable(const vector<Result>& results, long peakKb) {
+    printf("%-22s %-12s %6s %6s %8s %8s %8s %8s %10s %9s %8s %8s\n",
+           "maze", "query", "runs", "failed", "p50 ms", "p90 ms", "p99 ms", "max ms",
+           "expanded", "heap", "length", "map kB");
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result& res = results[r];
+        printf("%-22s %-12s %6zu %6zu %8.3f %8.3f %8.3f %8.3f %10.0f %9.0f %8.2f %8zu\n",
+               res.maze.c_str(), res.query.c_str(), res.latency.size(), res.failures,
+               percentile(res.latency, 0.5), percentile(res.latency, 0.9), percentile(res.latency, 0.99),
+               maximum(res.latency), mean(res.expansions), maximum(res.heapPeak), mean(res.length),
+               res.mapMemory);
+    }
+    printf("peak RSS of the run: %ld kB\n", peakKb);
+}
+
+static void writeCsv(const string& file, const vector<Result>& results) {
+    ofstream out(file.c_str());
+    out << "maze,query,size_m,density,runs,failures,p50_ms,p90_ms,p99_ms,max_ms,"
+        << "mean_expansions,max_heap,mean_length_m,map_kb" << endl;
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result& res = results[r];
+        out << res.maze << "," << res.query << "," << res.size << "," << res.density << ","
+            << res.latency.size() << "," << res.failures << ","
+            << percentile(res.latency, 0.5) << "," << percentile(res.latency, 0.9) << ","
+            << percentile(res.latency, 0.99) << "," << maximum(res.latency) << ","
+            << mean(res.expansions) << "," << maximum(res.heapPeak) << "," << mean(res.length) << ","
+            << res.mapMemory << endl;
+    }
+}
+
+static void writeJson(const string& file, const vector<Result>& results, int queries, unsigned int seed, bool useRoadmap,
+                      long peakKb) {
+    ofstream out(file.c_str());
+    out << "{" << endl;
+    out << "  \"queries\": " << queries << "," << endl;
+    out << "  \"seed\": " << seed << "," << endl;
+    out << "  \"roadmap\": " << (useRoadmap ? "true" : "false") << "," << endl;
+    out << "  \"peak_rss_kb\": " << peakKb << "," << endl;
+    out << "  \"results\": [" << endl;
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result& res = results[r];
+        out << "    {\"maze\": \"" << res.maze << "\", \"query\": \"" << res.query << "\""
+            << ", \"size_m\": " << res.size << ", \"density\": " << res.density
+            << ", \"runs\": " << res.latency.size() << ", \"failures\": " << res.failures
+            << ", \"latency_ms\": {\"p50\": " << percentile(res.latency, 0.5)
+            << ", \"p90\": " << percentile(res.latency, 0.9)
+            << ", \"p99\": " << percentile(res.latency, 0.99)
+            << ", \"max\": " << maximum(res.latency) << "}"
+            << ", \"mean_expansions\": " << mean(res.expansions)
+            << ", \"max_heap\": " << maximum(res.heapPeak)
+            << ", \"mean_length_m\": " << mean(res.length)
+            << ", \"map_kb\": " << res.mapMemory << "}"
+            << (r + 1 < results.size() ? "," : "") << endl;
+    }
+    out << "  ]" << endl;
+    out << "}" << endl;
+}
+
+static string absolutePath(const string& file) {
+    if (file.empty() || file[0] == '/') {
+        return file;
+    }
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) == 0) {
+        return file;
+    }
+    return string(cwd) + "/" + file;
+}
+
+int main(int argc, char **argv)
+{
+    string mapFile = getHomeDir()+"/catkin_ws/src/ras_maze/ras_maze_map/maps/lab_maze_2017.txt";
+    int queries = 50;
+    unsigned int seed = 1;
+    int maxSize = 24;
+    bool useRoadmap = true;
+    string csvFile;
+    string jsonFile;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool value = i + 1 < argc;
+        if (arg == "--map" && value) {
+            mapFile = argv[++i];
+        } else if (arg == "--queries" && value) {
+            queries = atoi(argv[++i]);
+        } else if (arg == "--seed" && value) {
+            seed = atoi(argv[++i]);
+        } else if (arg == "--max-size" && value) {
+            maxSize = atoi(argv[++i]);
+        } else if (arg == "--csv" && value) {
+            csvFile = argv[++i];
+        } else if (arg == "--json" && value) {
+            jsonFile = argv[++i];
+        } else if (arg == "--no-roadmap") {
+            useRoadmap = false;
+        } else {
+            cerr << "usage: planner_benchmark [--map FILE] [--queries N] [--seed S] [--max-size CELLS]"
+                 << " [--no-roadmap] [--csv FILE] [--json FILE]" << endl;
+            return 1;
+        }
+    }
+    mapFile = absolutePath(mapFile);
+    csvFile = absolutePath(csvFile);
+    jsonFile = absolutePath(jsonFile);
+
+    // the planner logs every snapped goal
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn)) {
+        ros::console::notifyLoggerLevelsChanged();
+    }
+
+    // the exploration writes its nodes to the working directory
+    char tmpDir[] = "/tmp/planner_benchmark_XXXXXX";
+    if (mkdtemp(tmpDir) == 0 || chdir(tmpDir) != 0) {
+        cerr << "Cannot create a working directory" << endl;
+        return 1;
+    }
+
+    vector<Maze> mazes;
+    if (ifstream(mapFile.c_str()).good()) {
+        Maze lab = {"lab_maze_2017", mapFile, 1.0, true};
+        mazes.push_back(lab);
+    } else {
+        cerr << "Map " << mapFile << " not found, only generated mazes are used" << endl;
+    }
+    double mazeCellSize = 0.6;
+    int sizes[4] = {4, 8, 16, 24};
+    double densities[3] = {1.0, 0.7, 0.4};
+    for (int s = 0; s < 4 && sizes[s] <= maxSize; s++) {
+        for (int d = 0; d < 3; d++) {
+            stringstream name;
+            name << "maze_" << sizes[s] << "x" << sizes[s] << "_d" << densities[d];
+            // the exploration path is quadratic in the explored area
+            Maze maze = {name.str(), string(tmpDir) + "/" + name.str() + ".txt", densities[d], sizes[s] <= 4};
+            writeMaze(maze.file, sizes[s], mazeCellSize, densities[d], seed + sizes[s]);
+            mazes.push_back(maze);
+        }
+    }
+
+    vector<Result> results;
+    for (size_t m = 0; m < mazes.size(); m++) {
+        cerr << "Benchmarking " << mazes[m].name << " ..." << endl;
+        vector<Result> mazeResults = benchmarkMaze(mazes[m], queries, seed, useRoadmap);
+        results.insert(results.end(), mazeResults.begin(), mazeResults.end());
+    }
+
+    // the maximum is process wide and never goes down, so it is reported once for the run
+    long peakKb = peakMemory();
+    printTable(results, peakKb);
+    if (!csvFile.empty()) {
+        writeCsv(csvFile, results);
+    }
+    if (!jsonFile.empty()) {
+        writeJson(jsonFile, results, queries, seed, useRoadmap, peakKb);
+    }
+
+    for (size_t m = 0; m < mazes.size(); m++) {
+        if (mazes[m].file.compare(0, strlen(tmpDir), tmpDir) == 0) {
+            unlink(mazes[m].file.c_str());
+        }
+    }
+    unlink("navigation_nodes.txt");
+    rmdir(tmpDir);
+    return 0;
+}
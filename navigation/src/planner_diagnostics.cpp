@@ -0,0 +1,164 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <algorithm>
+#include <ros/ros.h>
+#include "project_msgs/planner_diagnostics.h"
+
+#include <planner_diagnostics.h>
+
+using namespace std;
+
+PlannerDiagnostics::Histogram::Histogram(const string& p_metric, const vector<double>& p_bounds):
+    metric(p_metric),
+    bounds(p_bounds),
+    counts(p_bounds.size() + 1, 0),
+    sum(0),
+    max(0) {
+}
+
+void PlannerDiagnostics::Histogram::add(double value) {
+    size_t bin = upper_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+    counts[bin]++;
+    sum += value;
+    max = std::max(max, value);
+}
+
+PlannerDiagnostics::PlannerDiagnostics() {
+    windowStart = ros::Time::now();
+}
+
+PlannerDiagnostics::QueryStats PlannerDiagnostics::newQueryStats() {
+    QueryStats query;
+    query.count = 0;
+    query.failures = 0;
+    query.roadmapHits = 0;
+    query.slowest.wallTime = -1;
+    // logarithmic bins
+    double wallTime[] = {0.1, 0.3, 1, 3, 10, 30, 100, 300, 1000, 3000};
+    double expansions[] = {100, 300, 1e3, 3e3, 1e4, 3e4, 1e5, 3e5, 1e6};
+    double heapPeak[] = {10, 30, 100, 300, 1e3, 3e3, 1e4};
+    double pathCells[] = {10, 30, 100, 300, 1e3, 3e3, 1e4};
+    double snapDistance[] = {0, 1, 2, 4, 8, 16, 32};
+    query.histograms.push_back(Histogram("wall_time_ms", vector<double>(wallTime, wallTime + 10)));
+    query.histograms.push_back(Histogram("expansions", vector<double>(expansions, expansions + 9)));
+    query.histograms.push_back(Histogram("heap_peak", vector<double>(heapPeak, heapPeak + 7)));
+    query.histograms.push_back(Histogram("path_cells", vector<double>(pathCells, pathCells + 7)));
+    query.histograms.push_back(Histogram("snap_distance_cells", vector<double>(snapDistance, snapDistance + 7)));
+    return query;
+}
+
+void PlannerDiagnostics::record(const QueryRecord& record) {
+    lock_guard<mutex> lock(statsMutex);
+    map<string, QueryStats>::iterator it = stats.find(record.query);
+    if (it == stats.end()) {
+        it = stats.insert(pair<string, QueryStats>(record.query, newQueryStats())).first;
+    }
+    QueryStats& query = it->second;
+    query.count++;
+    if (!record.found) {
+        query.failures++;
+    }
+    if (record.roadmapHit) {
+        query.roadmapHits++;
+    }
+    query.histograms[0].add(record.wallTime);
+    query.histograms[1].add(record.expansions);
+    query.histograms[2].add(record.heapPeak);
+    query.histograms[3].add(record.pathCells);
+    query.histograms[4].add(record.snapDistance);
+    if (record.wallTime > query.slowest.wallTime) {
+        query.slowest = record;
+    }
+}
+
+void PlannerDiagnostics::publish(const ros::TimerEvent& event) {
+
+    map<string, QueryStats> window;
+    ros::Time now = ros::Time::now();
+    double period = (now - windowStart).toSec();
+    {
+        lock_guard<mutex> lock(statsMutex);
+        window.swap(stats);
+        windowStart = now;
+    }
+
+    for (map<string, QueryStats>::iterator it = window.begin(); it != window.end(); ++it) {
+        const QueryStats& query = it->second;
+        project_msgs::planner_diagnostics msg;
+        msg.stamp = now;
+        msg.period = period;
+        msg.query = it->first;
+        msg.count = query.count;
+        msg.failures = query.failures;
+        msg.roadmapHits = query.roadmapHits;
+        for (size_t h = 0; h < query.histograms.size(); h++) {
+            const Histogram& histogram = query.histograms[h];
+            project_msgs::planner_histogram hist;
+            hist.metric = histogram.metric;
+            hist.bounds = histogram.bounds;
+            hist.counts = histogram.counts;
+            hist.mean = histogram.sum/query.count;
+            hist.max = histogram.max;
+            msg.histograms.push_back(hist);
+        }
+        const QueryRecord& slowest = query.slowest;
+        stringstream s;
+        s << "(" << slowest.start.first << ", " << slowest.start.second << ") -> ("
+          << slowest.goal.first << ", " << slowest.goal.second << "): " << slowest.wallTime << " ms, "
+          << slowest.expansions << " expansions, heap " << slowest.heapPeak << ", "
+          << slowest.pathCells << " cells, snap " << slowest.snapDistance
+          << (slowest.roadmapHit ? ", roadmap" : "") << (slowest.found ? "" : ", not found");
+        msg.slowest = s.str();
+        pub.publish(msg);
+    }
+}
+
+static thread_local int probeDepth = 0;
+
+QueryProbe::QueryProbe(PlannerDiagnostics* p_diagnostics, const char* p_query,
+                       pair<double,double> p_start, pair<double,double> p_goal):
+    pathCells(0),
+    found(false),
+    diagnostics(p_diagnostics),
+    query(p_query),
+    start(p_start),
+    goal(p_goal),
+    outermost(probeDepth == 0) {
+    probeDepth++;
+    if (outermost && diagnostics) {
+        // measure this query alone, the counters are merged back when it ends
+        saved = searchStats();
+        searchStats() = SearchStats();
+        started = chrono::steady_clock::now();
+    }
+}
+
+QueryProbe::~QueryProbe() {
+    probeDepth--;
+    if (!outermost || !diagnostics) {
+        return;
+    }
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - started;
+    SearchStats& current = searchStats();
+    QueryRecord record;
+    record.query = query;
+    record.wallTime = elapsed.count();
+    record.expansions = current.expansions;
+    record.heapPeak = current.heapPeak;
+    record.pathCells = pathCells;
+    record.snapDistance = current.snapDistance;
+    record.roadmapHit = current.roadmapHits > 0;
+    record.found = found;
+    record.start = start;
+    record.goal = goal;
+    diagnostics->record(record);
+
+    saved.searches += current.searches;
+    saved.expansions += current.expansions;
+    saved.heapPeak = max(saved.heapPeak, current.heapPeak);
+    saved.snapDistance = max(saved.snapDistance, current.snapDistance);
+    saved.roadmapHits += current.roadmapHits;
+    current = saved;
+}
@@ -0,0 +1,194 @@
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <sstream>
+#include <ros/ros.h>
+#include "std_msgs/Float32MultiArray.h"
+
+#include <planning_executor.h>
+
+using namespace std;
+
+PlanningExecutor::PlanningExecutor(int p_threads, size_t p_maxQueue):
+    maxQueue(p_maxQueue),
+    seq(0),
+    stopping(false),
+    completed(0),
+    rejected(0),
+    cancelled(0),
+    maxLatency(0) {
+    for (int i = 0; i < p_threads; i++) {
+        workers.push_back(thread(&PlanningExecutor::worker, this));
+    }
+}
+
+PlanningExecutor::~PlanningExecutor() {
+    shutdown();
+}
+
+void PlanningExecutor::shutdown() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+        for (size_t i = 0; i < running.size(); i++) {
+            *running[i]->cancelled = true;
+        }
+    }
+    queueCondition.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+size_t PlanningExecutor::queueDepth() {
+    lock_guard<mutex> lock(queueMutex);
+    return queue.size();
+}
+
+bool PlanningExecutor::run(Priority priority, Job job) {
+    return submit(priority, job).get();
+}
+
+bool PlanningExecutor::post(Priority priority, Job job) {
+    future<bool> result = submit(priority, job);
+    // a rejected request is answered right away
+    return !(result.wait_for(chrono::seconds(0)) == future_status::ready && !result.get());
+}
+
+future<bool> PlanningExecutor::submit(Priority priority, Job job) {
+
+    shared_ptr<Request> request = make_shared<Request>();
+    request->priority = priority;
+    request->job = job;
+    request->cancelled = make_shared<atomic<bool> >(false);
+    request->submitted = chrono::steady_clock::now();
+    future<bool> result = request->done.get_future();
+
+    vector<shared_ptr<Request> > dropped;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        request->seq = seq++;
+        if (stopping) {
+            request->done.set_value(false);
+            return result;
+        }
+        if (priority == GOAL) {
+            // the robot can follow only the latest goal
+            size_t i = 0;
+            while (i < queue.size()) {
+                if (queue[i]->priority == GOAL) {
+                    dropped.push_back(queue[i]);
+                    queue.erase(queue.begin() + i);
+                    cancelled++;
+                } else {
+                    i++;
+                }
+            }
+            for (size_t i = 0; i < running.size(); i++) {
+                if (running[i]->priority == GOAL && !*running[i]->cancelled) {
+                    *running[i]->cancelled = true;
+                    cancelled++;
+                }
+            }
+        }
+        if (queue.size() >= maxQueue) {
+            // make room by dropping the newest request of the lowest priority
+            size_t lowest = 0;
+            for (size_t i = 1; i < queue.size(); i++) {
+                if (queue[i]->priority < queue[lowest]->priority ||
+                    (queue[i]->priority == queue[lowest]->priority && queue[i]->seq > queue[lowest]->seq)) {
+                    lowest = i;
+                }
+            }
+            rejected++;
+            if (queue[lowest]->priority < priority) {
+                dropped.push_back(queue[lowest]);
+                queue.erase(queue.begin() + lowest);
+            } else {
+                stringstream s;
+                s << "Planner queue is full (" << queue.size() << "), request rejected";
+                ROS_INFO("%s/n", s.str().c_str());
+                request->done.set_value(false);
+                return result;
+            }
+        }
+        queue.push_back(request);
+    }
+    queueCondition.notify_one();
+
+    for (size_t i = 0; i < dropped.size(); i++) {
+        *dropped[i]->cancelled = true;
+        dropped[i]->done.set_value(false);
+    }
+    return result;
+}
+
+void PlanningExecutor::worker() {
+    while (true) {
+        shared_ptr<Request> request;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (stopping) {
+                break;
+            }
+            // highest priority, the oldest first
+            size_t best = 0;
+            for (size_t i = 1; i < queue.size(); i++) {
+                if (queue[i]->priority > queue[best]->priority ||
+                    (queue[i]->priority == queue[best]->priority && queue[i]->seq < queue[best]->seq)) {
+                    best = i;
+                }
+            }
+            request = queue[best];
+            queue.erase(queue.begin() + best);
+            running.push_back(request);
+        }
+
+        try {
+            request->job(*request->cancelled);
+        } catch (const exception& e) {
+            ROS_ERROR("Planner request failed: %s", e.what());
+            *request->cancelled = true;
+        }
+        finish(request, !*request->cancelled);
+    }
+
+    // shutting down, release the waiting callers
+    lock_guard<mutex> lock(queueMutex);
+    while (!queue.empty()) {
+        queue.back()->done.set_value(false);
+        queue.pop_back();
+    }
+}
+
+void PlanningExecutor::finish(shared_ptr<Request> request, bool result) {
+
+    chrono::duration<double> latency = chrono::steady_clock::now() - request->submitted;
+    std_msgs::Float32MultiArray stats;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        running.erase(find(running.begin(), running.end(), request));
+        completed++;
+        maxLatency = max(maxLatency, latency.count());
+        // queue depth, running, latency, max latency, completed, rejected, cancelled
+        stats.data.push_back(queue.size());
+        stats.data.push_back(running.size());
+        stats.data.push_back(latency.count());
+        stats.data.push_back(maxLatency);
+        stats.data.push_back(completed);
+        stats.data.push_back(rejected);
+        stats.data.push_back(cancelled);
+    }
+    statsPub.publish(stats);
+
+    stringstream s;
+    s << "Planner request (priority " << request->priority << ") done in " << latency.count()
+      << " s, queue depth " << stats.data[0];
+    ROS_INFO("%s/n", s.str().c_str());
+
+    request->done.set_value(result);
+}
@@ -0,0 +1,122 @@
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+
+#include <rolling_grid.h>
+
+using namespace std;
+
+RollingGrid::RollingGrid(double p_cellSize, int p_cells, double p_halfLife):
+    size(p_cellSize),
+    cells(p_cells),
+    halfLife(p_halfLife),
+    hitGain(0.7),
+    missFactor(0.6),
+    threshold(0.5),
+    centreCellX(0),
+    centreCellY(0),
+    lastDecay(-1) {
+    for (int l = 0; l < LAYERS; l++) {
+        layers[l].assign(cells*cells, 0);
+    }
+}
+
+void RollingGrid::clearColumn(int ix) {
+    int x = wrap(ix);
+    for (int l = 0; l < LAYERS; l++) {
+        for (int y = 0; y < cells; y++) {
+            layers[l][y*cells + x] = 0;
+        }
+    }
+}
+
+void RollingGrid::clearRow(int iy) {
+    int y = wrap(iy);
+    for (int l = 0; l < LAYERS; l++) {
+        fill(layers[l].begin() + y*cells, layers[l].begin() + (y+1)*cells, 0.0f);
+    }
+}
+
+void RollingGrid::moveTo(double x, double y) {
+    int newX = floor(x/size);
+    int newY = floor(y/size);
+    int dx = newX - centreCellX;
+    int dy = newY - centreCellY;
+    if (abs(dx) >= cells || abs(dy) >= cells) {
+        for (int l = 0; l < LAYERS; l++) {
+            fill(layers[l].begin(), layers[l].end(), 0.0f);
+        }
+    } else {
+        // the columns (rows) that come in on one side take the storage of those
+        // that leave on the other side
+        int lowX = centreCellX - cells/2;
+        for (int ix = min(lowX, lowX + dx); ix < max(lowX, lowX + dx); ix++) {
+            clearColumn(ix);
+        }
+        int lowY = centreCellY - cells/2;
+        for (int iy = min(lowY, lowY + dy); iy < max(lowY, lowY + dy); iy++) {
+            clearRow(iy);
+        }
+    }
+    centreCellX = newX;
+    centreCellY = newY;
+}
+
+void RollingGrid::decay(double now) {
+    if (lastDecay >= 0 && now > lastDecay) {
+        float factor = pow(0.5, (now - lastDecay)/halfLife);
+        for (int l = 0; l < LAYERS; l++) {
+            float* cell = &layers[l][0];
+            for (int k = 0; k < cells*cells; k++) {
+                cell[k] *= factor;
+            }
+        }
+    }
+    lastDecay = now;
+}
+
+void RollingGrid::castRay(Layer layer, double x0, double y0, double x1, double y1, bool hit) {
+
+    // walks the cells the segment crosses, one cell border at a time (Amanatides & Woo)
+    vector<float>& cell = layers[layer];
+    double fx0 = x0/size;
+    double fy0 = y0/size;
+    double fx1 = x1/size;
+    double fy1 = y1/size;
+    int ix = floor(fx0);
+    int iy = floor(fy0);
+    int endX = floor(fx1);
+    int endY = floor(fy1);
+    // the direction of the beam, a beam within one column still leans to one side
+    int stepX = (fx1 > fx0) ? 1 : -1;
+    int stepY = (fy1 > fy0) ? 1 : -1;
+    double dx = fabs(fx1 - fx0);
+    double dy = fabs(fy1 - fy0);
+    double deltaX = (dx > 0) ? 1/dx : INFINITY;
+    double deltaY = (dy > 0) ? 1/dy : INFINITY;
+    double borderX = (stepX > 0) ? (ix + 1 - fx0) : (fx0 - ix);
+    double borderY = (stepY > 0) ? (iy + 1 - fy0) : (fy0 - iy);
+    double tX = (dx > 0) ? borderX*deltaX : INFINITY;
+    double tY = (dy > 0) ? borderY*deltaY : INFINITY;
+
+    // stops at the end cell, the bound only guards against rounding at the borders
+    int steps = abs(endX - ix) + abs(endY - iy);
+    for (int s = 0; s < steps && (ix != endX || iy != endY); s++) {
+        if (!inside(ix, iy)) {
+            return;
+        }
+        cell[index(ix, iy)] *= missFactor;
+        if (tX < tY) {
+            ix += stepX;
+            tX += deltaX;
+        } else {
+            iy += stepY;
+            tY += deltaY;
+        }
+    }
+    if (hit && inside(endX, endY)) {
+        float& end = cell[index(endX, endY)];
+        end += hitGain*(1 - end);
+    }
+}
@@ -0,0 +1,150 @@
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include <route_ordering.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+int routeLength(const vector<vector<int> >& dist, const vector<int>& tour) {
+    int length = 0;
+    for (size_t i = 1; i < tour.size(); i++) {
+        length += dist[tour[i-1]][tour[i]];
+    }
+    return length;
+}
+
+static vector<int> nearestNeighbour(const vector<vector<int> >& dist) {
+    int n = dist.size();
+    vector<int> tour(1, 0);
+    vector<char> visited(n, 0);
+    visited[0] = 1;
+    for (int count = 1; count < n; count++) {
+        int last = tour.back();
+        int jMin = -1;
+        for (int j = 1; j < n; j++) {
+            if (!visited[j] && (jMin == -1 || dist[last][j] < dist[last][jMin])) {
+                jMin = j;
+            }
+        }
+        tour.push_back(jMin);
+        visited[jMin] = 1;
+    }
+    return tour;
+}
+
+// reverse tour[i..j], the start (tour[0]) is fixed and the end is open
+static bool twoOpt(const vector<vector<int> >& dist, vector<int>& tour) {
+    int n = tour.size() - 1;
+    bool improved = false;
+    for (int i = 1; i < n; i++) {
+        for (int j = i + 1; j <= n; j++) {
+            int a = tour[i-1], b = tour[i], c = tour[j];
+            int delta = dist[a][c] - dist[a][b];
+            if (j < n) {
+                int e = tour[j+1];
+                delta += dist[b][e] - dist[c][e];
+            }
+            if (delta < 0) {
+                reverse(tour.begin() + i, tour.begin() + j + 1);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+// move a segment of up to 3 targets (possibly reversed) to another place
+static bool orOpt(const vector<vector<int> >& dist, vector<int>& tour) {
+    int n = tour.size() - 1;
+    bool improved = false;
+    for (int len = 1; len <= 3; len++) {
+        for (int i = 1; i + len - 1 <= n; i++) {
+            int prev = tour[i-1];
+            int first = tour[i];
+            int last = tour[i+len-1];
+            int gain = dist[prev][first];
+            if (i + len <= n) {
+                int next = tour[i+len];
+                gain += dist[last][next] - dist[prev][next];
+            }
+            for (int k = 0; k <= n; k++) {
+                if (k >= i - 1 && k <= i + len - 1) {
+                    continue;
+                }
+                int a = tour[k];
+                int cost = dist[a][first];
+                int costRev = dist[a][last];
+                if (k + 1 <= n) {
+                    int b = tour[k+1];
+                    cost += dist[last][b] - dist[a][b];
+                    costRev += dist[first][b] - dist[a][b];
+                }
+                bool rev = costRev < cost;
+                if (min(cost, costRev) < gain) {
+                    vector<int> segment(tour.begin() + i, tour.begin() + i + len);
+                    if (rev) {
+                        reverse(segment.begin(), segment.end());
+                    }
+                    tour.erase(tour.begin() + i, tour.begin() + i + len);
+                    int pos = (k > i) ? k - len + 1 : k + 1;
+                    tour.insert(tour.begin() + pos, segment.begin(), segment.end());
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    return improved;
+}
+
+static void localSearch(const vector<vector<int> >& dist, vector<int>& tour, Clock::time_point deadline) {
+    bool improved = true;
+    while (improved && Clock::now() < deadline) {
+        improved = twoOpt(dist, tour);
+        improved = orOpt(dist, tour) || improved;
+    }
+}
+
+vector<int> orderRoute(const vector<vector<int> >& dist, double timeBudget) {
+
+    Clock::time_point deadline = Clock::now() +
+        chrono::duration_cast<Clock::duration>(chrono::duration<double>(timeBudget));
+    int n = dist.size() - 1;
+    if (n <= 0) {
+        return vector<int>();
+    }
+
+    vector<int> tour = nearestNeighbour(dist);
+    localSearch(dist, tour, deadline);
+    vector<int> best = tour;
+    int bestLength = routeLength(dist, best);
+
+    // iterated local search: random segment perturbation of the best tour
+    if (n > 3) {
+        mt19937 generator(n);
+        uniform_int_distribution<int> position(1, n);
+        while (Clock::now() < deadline) {
+            tour = best;
+            for (int kick = 0; kick < 2; kick++) {
+                int i = position(generator);
+                int j = position(generator);
+                if (i > j) {
+                    swap(i, j);
+                }
+                reverse(tour.begin() + i, tour.begin() + j + 1);
+            }
+            localSearch(dist, tour, deadline);
+            int length = routeLength(dist, tour);
+            if (length < bestLength) {
+                best = tour;
+                bestLength = length;
+            }
+        }
+    }
+
+    return vector<int>(best.begin() + 1, best.end());
+}
@@ -0,0 +1,123 @@
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <math.h>
+
+#include <safety_zone.h>
+
+using namespace std;
+
+double SafetyZone::bucketValue(int k, int buckets, double maxValue) {
+    int half = buckets/2;
+    return (half > 0) ? maxValue*(k - half)/half : 0;
+}
+
+int SafetyZone::bucket(double value, int buckets, double maxValue) {
+    int half = buckets/2;
+    if (half == 0) {
+        return 0;
+    }
+    // away from zero, so the zone is never smaller than the one of the command
+    double steps = value/maxValue*half;
+    int k = (steps >= 0) ? (int)ceil(steps - 1e-9) : (int)floor(steps + 1e-9);
+    return min(max(k, -half), half) + half;
+}
+
+void SafetyZone::trajectory(double linVel, double angVel, vector<pair<double,double> >& centres) const {
+
+    // constant command for the latency, then both velocities brake at their limits
+    centres.clear();
+    double x = 0;
+    double y = 0;
+    double theta = 0;
+    double v = linVel;
+    double w = angVel;
+    double t = 0;
+    double dt = 0.005;
+    double travelled = 0;
+    while (v != 0) {
+        if (t >= limits.latency) {
+            v = (v > 0) ? max(0.0, v - limits.linDecel*dt) : min(0.0, v + limits.linDecel*dt);
+            w = (w > 0) ? max(0.0, w - limits.angDecel*dt) : min(0.0, w + limits.angDecel*dt);
+        }
+        x += v*cos(theta)*dt;
+        y += v*sin(theta)*dt;
+        theta += w*dt;
+        travelled += fabs(v)*dt;
+        t += dt;
+        // discs half a radius apart overlap enough to leave no gap at the robot's width
+        if (travelled >= robotRad/2) {
+            centres.push_back(pair<double,double>(x, y));
+            travelled = 0;
+        }
+    }
+    if (travelled > 0) {
+        centres.push_back(pair<double,double>(x, y));
+    }
+}
+
+void SafetyZone::build(const shared_ptr<const BeamTable>& robotBeams,
+                       const vector<float>& staticMin, const vector<float>& staticMax) {
+    beams = robotBeams;
+    size_t n = beams->size;
+    int buckets = limits.linBuckets*limits.angBuckets;
+    insideMin.resize(buckets*n);
+    insideMax.resize(buckets*n);
+    double ox = beams->geometry.x;
+    double oy = beams->geometry.y;
+    double r2 = robotRad*robotRad;
+    vector<pair<double,double> > centres;
+    for (int l = 0; l < limits.linBuckets; l++) {
+        for (int a = 0; a < limits.angBuckets; a++) {
+            trajectory(bucketValue(l, limits.linBuckets, limits.maxLin),
+                       bucketValue(a, limits.angBuckets, limits.maxAng), centres);
+            float* low = &insideMin[(l*limits.angBuckets + a)*n];
+            float* high = &insideMax[(l*limits.angBuckets + a)*n];
+            for (size_t i = 0; i < n; i++) {
+                low[i] = staticMin[i];
+                high[i] = staticMax[i];
+                // the beam from (ox, oy) along (c, s) is in a disc at range r where
+                // r^2 + b*r + q <= 0; the discs overlap, the hull of their intervals is the zone
+                double c = beams->cosAngles[i];
+                double s = beams->sinAngles[i];
+                for (size_t k = 0; k < centres.size(); k++) {
+                    double dx = ox - centres[k].first;
+                    double dy = oy - centres[k].second;
+                    double b = 2*(c*dx + s*dy);
+                    double q = dx*dx + dy*dy - r2;
+                    double discriminant = b*b - 4*q;
+                    if (discriminant < 0) {
+                        continue;
+                    }
+                    double far = (-b + sqrt(discriminant))/2;
+                    if (far < 0) {
+                        continue;
+                    }
+                    double near = max(0.0, (-b - sqrt(discriminant))/2);
+                    if (low[i] > high[i]) {
+                        low[i] = near;
+                        high[i] = far;
+                    } else {
+                        low[i] = min((double)low[i], near);
+                        high[i] = max((double)high[i], far);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int SafetyZone::violations(const vector<float>& ranges, double linVel, double angVel) const {
+    size_t n = min(ranges.size(), beams->size);
+    int b = bucket(linVel, limits.linBuckets, limits.maxLin)*limits.angBuckets +
+            bucket(angVel, limits.angBuckets, limits.maxAng);
+    const float* r = ranges.data();
+    const float* low = &insideMin[b*beams->size];
+    const float* high = &insideMax[b*beams->size];
+    // inf and nan ranges compare false
+    int count = 0;
+    for (size_t i = 0; i < n; i++) {
+        count += (r[i] >= low[i]) & (r[i] <= high[i]);
+    }
+    return count;
+}
@@ -0,0 +1,102 @@
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <math.h>
+
+#include <scan_preprocessor.h>
+
+using namespace std;
+
+BeamTable::BeamTable(const ScanGeometry& p_geometry, size_t p_size, float p_angleIncrement):
+    geometry(p_geometry),
+    size(p_size),
+    angleIncrement(p_angleIncrement),
+    angles(p_size),
+    cosAngles(p_size),
+    sinAngles(p_size) {
+    for (size_t i = 0; i < size; i++) {
+        angles[i] = geometry.startAngle + geometry.direction*i*angleIncrement;
+        cosAngles[i] = cos(angles[i]);
+        sinAngles[i] = sin(angles[i]);
+    }
+}
+
+vector<size_t> PreprocessedScan::sample(int n) const {
+    vector<size_t> beams;
+    size_t step = (n > 0) ? max((size_t)1, size()/n) : 1;
+    for (size_t first = 0; first < size(); first += step) {
+        size_t last = min(first + step, size());
+        for (size_t i = first; i < last; i++) {
+            if (valid[i]) {
+                beams.push_back(i);
+                break;
+            }
+        }
+    }
+    return beams;
+}
+
+vector<pair<float,float> > PreprocessedScan::sampleMeasurements(int n, float maxRange) const {
+    vector<size_t> beams = sample(n);
+    vector<pair<float,float> > measurements;
+    measurements.reserve(beams.size());
+    for (size_t k = 0; k < beams.size(); k++) {
+        measurements.push_back(pair<float,float>(angle(beams[k]), min(range(beams[k]), maxRange)));
+    }
+    return measurements;
+}
+
+// the latest scans and tables, a few since emergency_stop uses a geometry of its own
+static const size_t cacheSize = 4;
+static mutex cacheMutex;
+static vector<shared_ptr<const PreprocessedScan> > scanCache;
+static vector<shared_ptr<const BeamTable> > tableCache;
+
+shared_ptr<const PreprocessedScan> ScanPreprocessor::preprocess(const sensor_msgs::LaserScan::ConstPtr& msg,
+                                                                const ScanGeometry& geometry) {
+    shared_ptr<const BeamTable> table;
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        for (size_t k = 0; k < scanCache.size(); k++) {
+            // the cached scan holds its message, so the address can not be reused meanwhile
+            if (scanCache[k]->msg == msg && scanCache[k]->beams->geometry == geometry) {
+                return scanCache[k];
+            }
+        }
+        for (size_t k = 0; k < tableCache.size() && !table; k++) {
+            if (tableCache[k]->matches(geometry, msg->ranges.size(), msg->angle_increment)) {
+                table = tableCache[k];
+            }
+        }
+        if (!table) {
+            table = make_shared<BeamTable>(geometry, msg->ranges.size(), msg->angle_increment);
+            tableCache.insert(tableCache.begin(), table);
+            tableCache.resize(min(tableCache.size(), cacheSize));
+        }
+    }
+
+    shared_ptr<PreprocessedScan> scan = make_shared<PreprocessedScan>();
+    scan->msg = msg;
+    scan->beams = table;
+    size_t n = msg->ranges.size();
+    scan->valid.assign(n, 0);
+    scan->x.assign(n, 0);
+    scan->y.assign(n, 0);
+    scan->validCount = 0;
+    for (size_t i = 0; i < n; i++) {
+        float r = msg->ranges[i];
+        if (isfinite(r)) {
+            scan->valid[i] = 1;
+            scan->x[i] = r*table->cosAngles[i] + geometry.x;
+            scan->y[i] = r*table->sinAngles[i] + geometry.y;
+            scan->validCount++;
+        }
+    }
+
+    // two consumers may have raced on the same scan, both results are equal
+    lock_guard<mutex> lock(cacheMutex);
+    scanCache.insert(scanCache.begin(), scan);
+    scanCache.resize(min(scanCache.size(), cacheSize));
+    return scan;
+}
@@ -0,0 +1,337 @@
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+#include <skeleton_roadmap.h>
+#include <search_stats.h>
+
+using namespace std;
+
+// 8-connected moves, the first four are the 4-connected ones
+static const int MOVE_X[8] = {-1, 1, 0, 0, -1, -1, 1, 1};
+static const int MOVE_Y[8] = {0, 0, -1, 1, -1, 1, -1, 1};
+static const unsigned char START_CELL = 9;
+static const int NO_DISTANCE = numeric_limits<int>::max();
+// closest obstacle cells of two neighbours further apart than this (squared, cells)
+// and than the clearance belong to different walls
+static const int MIN_SEPARATION = 8;
+// smaller skeleton pieces come from the roughness of the walls
+static const size_t MIN_COMPONENT = 20;
+// skeleton marks
+static const unsigned char SKELETON = 1;
+static const unsigned char PRUNED = 2;
+
+void SkeletonRoadmap::build(const GridMap& grid) {
+
+    nx = grid.nx;
+    ny = grid.ny;
+    version = grid.version;
+    dist = TiledGrid<int>(nx, ny, NO_DISTANCE);
+    site = TiledGrid<int>(nx, ny, -1);
+    skeleton = TiledGrid<unsigned char>(nx, ny, 0);
+
+    // brushfire from the walls facing the free space
+    Queue open;
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            if (grid.get(i, j) == 0) {
+                continue;
+            }
+            dist.set(i, j, 0);
+            site.set(i, j, i*ny + j);
+            for (int k = 0; k < 4; k++) {
+                int x = i + MOVE_X[k];
+                int y = j + MOVE_Y[k];
+                if (x >= 0 && x < nx && y >= 0 && y < ny && grid.get(x, y) == 0) {
+                    open.push(Entry(0, i*ny + j));
+                    break;
+                }
+            }
+        }
+    }
+    pair<int,int> minCell(0, 0);
+    pair<int,int> maxCell(nx-1, ny-1);
+    propagate(grid, open, minCell, maxCell);
+    markSkeleton(grid, pair<int,int>(0, 0), pair<int,int>(nx-1, ny-1));
+    prune();
+    dist.compress();
+    site.compress();
+    skeleton.compress();
+}
+
+void SkeletonRoadmap::update(const GridMap& grid, pair<int,int> minCell, pair<int,int> maxCell) {
+
+    version = grid.version;
+    minCell = pair<int,int>(max(minCell.first, 0), max(minCell.second, 0));
+    maxCell = pair<int,int>(min(maxCell.first, nx-1), min(maxCell.second, ny-1));
+
+    // new wall cells start a wave which only lowers the distances,
+    // it stops where the old walls are closer
+    Queue open;
+    pair<int,int> changedMin(nx, ny);
+    pair<int,int> changedMax(-1, -1);
+    for (int i = minCell.first; i <= maxCell.first; i++) {
+        for (int j = minCell.second; j <= maxCell.second; j++) {
+            if (grid.get(i, j) != 0 && dist.get(i, j) != 0) {
+                dist.set(i, j, 0);
+                site.set(i, j, i*ny + j);
+                open.push(Entry(0, i*ny + j));
+                changedMin = pair<int,int>(min(changedMin.first, i), min(changedMin.second, j));
+                changedMax = pair<int,int>(max(changedMax.first, i), max(changedMax.second, j));
+            }
+        }
+    }
+    if (open.empty()) {
+        return;
+    }
+    propagate(grid, open, changedMin, changedMax);
+    // marks depend on the neighbours
+    markSkeleton(grid, pair<int,int>(changedMin.first - 1, changedMin.second - 1),
+                       pair<int,int>(changedMax.first + 1, changedMax.second + 1));
+    prune();
+    dist.compress();
+    site.compress();
+    skeleton.compress();
+}
+
+double SkeletonRoadmap::clearance(int i, int j) const {
+    int d = dist.get(i, j);
+    if (d == NO_DISTANCE) {
+        return numeric_limits<double>::infinity();
+    }
+    return sqrt(d);
+}
+
+// extends [minCell, maxCell] by the cells that got a closer obstacle
+void SkeletonRoadmap::propagate(const GridMap& grid, Queue& open, pair<int,int>& minCell, pair<int,int>& maxCell) {
+    while (!open.empty()) {
+        Entry entry = open.top();
+        open.pop();
+        int x = entry.second / ny;
+        int y = entry.second % ny;
+        if (entry.first != dist.get(x, y)) {
+            // a closer obstacle was found meanwhile
+            continue;
+        }
+        int s = site.get(x, y);
+        int sx = s / ny;
+        int sy = s % ny;
+        for (int k = 0; k < 8; k++) {
+            int i = x + MOVE_X[k];
+            int j = y + MOVE_Y[k];
+            if (i < 0 || i >= nx || j < 0 || j >= ny || grid.get(i, j) != 0) {
+                continue;
+            }
+            int d = (i - sx)*(i - sx) + (j - sy)*(j - sy);
+            if (d < dist.get(i, j)) {
+                dist.set(i, j, d);
+                site.set(i, j, s);
+                open.push(Entry(d, i*ny + j));
+                minCell = pair<int,int>(min(minCell.first, i), min(minCell.second, j));
+                maxCell = pair<int,int>(max(maxCell.first, i), max(maxCell.second, j));
+            }
+        }
+    }
+}
+
+void SkeletonRoadmap::markSkeleton(const GridMap& grid, pair<int,int> minCell, pair<int,int> maxCell) {
+    for (int i = max(minCell.first, 0); i <= min(maxCell.first, nx-1); i++) {
+        for (int j = max(minCell.second, 0); j <= min(maxCell.second, ny-1); j++) {
+            bool mark = false;
+            int s = site.get(i, j);
+            if (grid.get(i, j) == 0 && s >= 0) {
+                int d = dist.get(i, j);
+                for (int k = 0; k < 4 && !mark; k++) {
+                    int x = i + MOVE_X[k];
+                    int y = j + MOVE_Y[k];
+                    if (x < 0 || x >= nx || y < 0 || y >= ny || grid.get(x, y) != 0) {
+                        continue;
+                    }
+                    int t = site.get(x, y);
+                    if (t < 0 || t == s) {
+                        continue;
+                    }
+                    int dx = s / ny - t / ny;
+                    int dy = s % ny - t % ny;
+                    int separation = dx*dx + dy*dy;
+                    // of the two cells around the middle line, the one closer to its wall is marked
+                    if (separation > max(MIN_SEPARATION, d) && d <= dist.get(x, y)) {
+                        mark = true;
+                    }
+                }
+            }
+            if (mark != (skeleton.get(i, j) != 0)) {
+                skeleton.set(i, j, mark ? SKELETON : 0);
+            }
+        }
+    }
+}
+
+// keeps the connected pieces of the skeleton of at least MIN_COMPONENT cells
+void SkeletonRoadmap::prune() {
+
+    int tileSize = TiledGrid<unsigned char>::TILE_SIZE;
+    TiledGrid<unsigned char> seen(nx, ny, 0);
+    skeletonCells = 0;
+    for (size_t ti = 0; ti < skeleton.tileCountX(); ti++) {
+        for (size_t tj = 0; tj < skeleton.tileCountY(); tj++) {
+            unsigned char value;
+            if (skeleton.uniformTile(ti, tj, value) && value == 0) {
+                continue;
+            }
+            for (int i = ti*tileSize; i < min((int)(ti+1)*tileSize, nx); i++) {
+                for (int j = tj*tileSize; j < min((int)(tj+1)*tileSize, ny); j++) {
+                    if (skeleton.get(i, j) == 0 || seen.get(i, j) != 0) {
+                        continue;
+                    }
+                    vector<int> component(1, i*ny + j);
+                    seen.set(i, j, 1);
+                    for (size_t c = 0; c < component.size(); c++) {
+                        int x = component[c] / ny;
+                        int y = component[c] % ny;
+                        for (int k = 0; k < 8; k++) {
+                            int a = x + MOVE_X[k];
+                            int b = y + MOVE_Y[k];
+                            if (a >= 0 && a < nx && b >= 0 && b < ny &&
+                                skeleton.get(a, b) != 0 && seen.get(a, b) == 0) {
+                                seen.set(a, b, 1);
+                                component.push_back(a*ny + b);
+                            }
+                        }
+                    }
+                    unsigned char mark = PRUNED;
+                    if (component.size() >= MIN_COMPONENT) {
+                        mark = SKELETON;
+                        skeletonCells += component.size();
+                    }
+                    for (size_t c = 0; c < component.size(); c++) {
+                        skeleton.set(component[c] / ny, component[c] % ny, mark);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Breadth first search for the closest skeleton cell */
+// path goes from cell to the skeleton
+bool SkeletonRoadmap::connect(const GridMap& grid, pair<int,int> cell, int maxConnect, vector<pair<int,int> >& path) const {
+
+    TiledGrid<unsigned char> prev(nx, ny, 0);
+    prev.set(cell.first, cell.second, START_CELL);
+    vector<int> layer(1, cell.first*ny + cell.second);
+    int found = -1;
+    for (int depth = 0; depth <= maxConnect && found < 0 && !layer.empty(); depth++) {
+        vector<int> next;
+        for (size_t c = 0; c < layer.size() && found < 0; c++) {
+            int x = layer[c] / ny;
+            int y = layer[c] % ny;
+            if (onSkeleton(x, y)) {
+                found = layer[c];
+                break;
+            }
+            for (int k = 0; k < 4; k++) {
+                int i = x + MOVE_X[k];
+                int j = y + MOVE_Y[k];
+                if (i >= 0 && i < nx && j >= 0 && j < ny &&
+                    grid.get(i, j) == 0 && prev.get(i, j) == 0) {
+                    prev.set(i, j, k + 1);
+                    next.push_back(i*ny + j);
+                }
+            }
+        }
+        layer.swap(next);
+    }
+    if (found < 0) {
+        return false;
+    }
+
+    path.clear();
+    int x = found / ny;
+    int y = found % ny;
+    path.push_back(pair<int,int>(x, y));
+    while (!(x == cell.first && y == cell.second)) {
+        int k = prev.get(x, y) - 1;
+        x -= MOVE_X[k];
+        y -= MOVE_Y[k];
+        path.push_back(pair<int,int>(x, y));
+    }
+    reverse(path.begin(), path.end());
+    return true;
+}
+
+/* A* over the skeleton cells */
+vector<pair<int,int> > SkeletonRoadmap::getPath(const GridMap& grid, pair<int,int> start, pair<int,int> goal, int maxConnect) const {
+
+    vector<pair<int,int> > toSkeleton;
+    vector<pair<int,int> > fromSkeleton;
+    if (nx == 0 || !connect(grid, start, maxConnect, toSkeleton) || !connect(grid, goal, maxConnect, fromSkeleton)) {
+        return vector<pair<int,int> >();
+    }
+    pair<int,int> entry = toSkeleton.back();
+    pair<int,int> exit = fromSkeleton.back();
+
+    typedef pair<double,int> Candidate;
+    priority_queue<Candidate, vector<Candidate>, greater<Candidate> > open;
+    TiledGrid<float> cost(nx, ny, numeric_limits<float>::infinity());
+    TiledGrid<unsigned char> prev(nx, ny, 0);
+    cost.set(entry.first, entry.second, 0);
+    prev.set(entry.first, entry.second, START_CELL);
+    open.push(Candidate(hypot(exit.first - entry.first, exit.second - entry.second), entry.first*ny + entry.second));
+    bool found = false;
+    size_t expansions = 0;
+    size_t heapPeak = 1;
+    while (!open.empty()) {
+        Candidate candidate = open.top();
+        open.pop();
+        int x = candidate.second / ny;
+        int y = candidate.second % ny;
+        if (x == exit.first && y == exit.second) {
+            found = true;
+            break;
+        }
+        float g = cost.get(x, y);
+        if (candidate.first > g + hypot(exit.first - x, exit.second - y) + 1e-3) {
+            continue;
+        }
+        for (int k = 0; k < 8; k++) {
+            int i = x + MOVE_X[k];
+            int j = y + MOVE_Y[k];
+            if (i < 0 || i >= nx || j < 0 || j >= ny || !onSkeleton(i, j) || grid.get(i, j) != 0) {
+                continue;
+            }
+            float step = (k < 4) ? 1.0 : M_SQRT2;
+            if (g + step < cost.get(i, j)) {
+                cost.set(i, j, g + step);
+                prev.set(i, j, k + 1);
+                open.push(Candidate(g + step + hypot(exit.first - i, exit.second - j), i*ny + j));
+            }
+        }
+        heapPeak = max(heapPeak, open.size());
+        expansions++;
+    }
+    SearchStats& stats = searchStats();
+    stats.searches++;
+    stats.expansions += expansions;
+    stats.heapPeak = max(stats.heapPeak, heapPeak);
+    if (!found) {
+        return vector<pair<int,int> >();
+    }
+
+    // start -> entry, entry -> exit along the skeleton, exit -> goal
+    vector<pair<int,int> > along;
+    int x = exit.first;
+    int y = exit.second;
+    while (!(x == entry.first && y == entry.second)) {
+        along.push_back(pair<int,int>(x, y));
+        int k = prev.get(x, y) - 1;
+        x -= MOVE_X[k];
+        y -= MOVE_Y[k];
+    }
+    vector<pair<int,int> > path(toSkeleton);
+    path.insert(path.end(), along.rbegin(), along.rend());
+    path.insert(path.end(), fromSkeleton.rbegin() + 1, fromSkeleton.rend());
+    return path;
+}
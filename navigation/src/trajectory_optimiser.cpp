@@ -0,0 +1,172 @@
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include <trajectory_optimiser.h>
+
+using namespace std;
+
+TrajectoryOptimiser::TrajectoryOptimiser(double p_robotRad, const TrajectoryLimits& p_limits):
+    headingWeight(1.0),
+    progressWeight(1.0),
+    clearanceWeight(0.3),
+    velocityWeight(0.4),
+    margin(0.05),
+    robotRad(p_robotRad),
+    limits(p_limits),
+    cellSize(0.04) {
+    linCount = round(limits.maxLin/limits.linStep) + 1;
+    angCount = 2*round(limits.maxAng/limits.angStep) + 1;
+    // the longest arc with the robot around its end
+    cells = 2*ceil((limits.maxLin*limits.horizon + robotRad)/cellSize + 1);
+    occupied.assign(cells*cells, 0);
+    buildTemplates();
+}
+
+void TrajectoryOptimiser::buildTemplates() {
+
+    int arcs = linCount*angCount;
+    endX.assign(arcs, 0);
+    endY.assign(arcs, 0);
+    endTheta.assign(arcs, 0);
+    arcLength.assign(arcs, 0);
+    templateFirst.assign(arcs + 1, 0);
+    templateCell.clear();
+    templateLength.clear();
+
+    double reach = robotRad + cellSize*M_SQRT1_2;   // a cell touches the disc
+    int span = ceil(reach/cellSize);
+    vector<float> first(cells*cells);
+    vector<int> touched;
+    for (int l = 0; l < linCount; l++) {
+        for (int a = 0; a < angCount; a++) {
+            int k = l*angCount + a;
+            double v = l*limits.linStep;
+            double w = (a - angCount/2)*limits.angStep;
+            // the template runs margin further, so short arcs still see what is just beyond
+            double length = v*limits.horizon;
+            double swept = (v > 0) ? length + margin : 0;
+            fill(first.begin(), first.end(), -1.0f);
+            touched.clear();
+            int steps = ceil(swept/(cellSize/2));
+            double x = 0;
+            double y = 0;
+            double theta = 0;
+            for (int s = 1; s <= steps; s++) {
+                // exact pose on the arc at arc length d
+                double d = swept*s/steps;
+                if (fabs(w) < 1e-9) {
+                    x = d;
+                    y = 0;
+                    theta = 0;
+                } else {
+                    theta = d*w/v;
+                    x = sin(theta)*v/w;
+                    y = (1 - cos(theta))*v/w;
+                }
+                int cx = floor(x/cellSize) + cells/2;
+                int cy = floor(y/cellSize) + cells/2;
+                for (int iy = max(0, cy - span); iy <= min(cells - 1, cy + span); iy++) {
+                    for (int ix = max(0, cx - span); ix <= min(cells - 1, cx + span); ix++) {
+                        double px = (ix - cells/2 + 0.5)*cellSize;
+                        double py = (iy - cells/2 + 0.5)*cellSize;
+                        // a cell is on the way where the robot reaches it coming closer,
+                        // not where it only passes alongside or already touches it
+                        double distance = hypot(px - x, py - y);
+                        if (distance > reach || distance >= hypot(px, py) - cellSize/4) {
+                            continue;
+                        }
+                        int cell = iy*cells + ix;
+                        if (first[cell] < 0) {
+                            first[cell] = d;
+                            touched.push_back(cell);
+                        }
+                    }
+                }
+            }
+            sort(touched.begin(), touched.end());
+            for (size_t t = 0; t < touched.size(); t++) {
+                templateCell.push_back(touched[t]);
+                templateLength.push_back(first[touched[t]]);
+            }
+            templateFirst[k+1] = templateCell.size();
+            arcLength[k] = swept;
+            // where the arc ends after the horizon, for the score
+            endTheta[k] = w*limits.horizon;
+            if (fabs(w) < 1e-9) {
+                endX[k] = length;
+                endY[k] = 0;
+            } else {
+                endX[k] = sin(endTheta[k])*v/w;
+                endY[k] = (1 - cos(endTheta[k]))*v/w;
+            }
+        }
+    }
+}
+
+float TrajectoryOptimiser::clearance(int k) const {
+    const int* cell = &templateCell[0];
+    const float* length = &templateLength[0];
+    const unsigned char* grid = &occupied[0];
+    float free = arcLength[k];
+    // branch free, the compiler vectorises the selects
+    for (int t = templateFirst[k]; t < templateFirst[k+1]; t++) {
+        float hit = grid[cell[t]] ? length[t] : free;
+        free = min(free, hit);
+    }
+    return free;
+}
+
+pair<double,double> TrajectoryOptimiser::plan(const vector<float>& obstacleX, const vector<float>& obstacleY,
+                                              double targetX, double targetY, bool waypoint,
+                                              double currentLin, double currentAng) {
+
+    fill(occupied.begin(), occupied.end(), 0);
+    for (size_t i = 0; i < obstacleX.size(); i++) {
+        int ix = floor(obstacleX[i]/cellSize) + cells/2;
+        int iy = floor(obstacleY[i]/cellSize) + cells/2;
+        if (ix >= 0 && ix < cells && iy >= 0 && iy < cells) {
+            occupied[iy*cells + ix] = 1;
+        }
+    }
+
+    // the dynamic window: what the wheels can reach within one period
+    int linLow = max(0, (int)ceil((currentLin - limits.linAcc*limits.period)/limits.linStep - 1e-9));
+    int linHigh = min(linCount - 1, (int)floor((currentLin + limits.linAcc*limits.period)/limits.linStep + 1e-9));
+    int angLow = max(0, (int)ceil((currentAng - limits.angAcc*limits.period)/limits.angStep - 1e-9) + angCount/2);
+    int angHigh = min(angCount - 1, (int)floor((currentAng + limits.angAcc*limits.period)/limits.angStep + 1e-9) + angCount/2);
+
+    double targetDistance = hypot(targetX, targetY);
+    double maxLength = limits.maxLin*limits.horizon;
+    if (waypoint && targetDistance > 0 && targetDistance < maxLength) {
+        // only the direction of a point on the way counts, the robot goes on past it
+        targetX *= maxLength/targetDistance;
+        targetY *= maxLength/targetDistance;
+        targetDistance = maxLength;
+    }
+    double bestScore = -INFINITY;
+    pair<double,double> best(max(0.0, currentLin - limits.linAcc*limits.period), currentAng);
+    for (int l = linLow; l <= linHigh; l++) {
+        double v = l*limits.linStep;
+        double braking = v*v/(2*limits.linAcc) + v*limits.period;
+        for (int a = angLow; a <= angHigh; a++) {
+            int k = l*angCount + a;
+            float free = clearance(k);
+            if (free < arcLength[k] && free <= braking + margin) {
+                continue;
+            }
+            double toTarget = atan2(targetY - endY[k], targetX - endX[k]) - endTheta[k];
+            toTarget = fabs(atan2(sin(toTarget), cos(toTarget)));
+            double heading = 1 - toTarget/M_PI;
+            double progress = (targetDistance - hypot(targetX - endX[k], targetY - endY[k]))/maxLength;
+            double clear = (free < arcLength[k]) ? free/maxLength : 1.0;
+            double score = headingWeight*heading + progressWeight*progress +
+                           clearanceWeight*clear + velocityWeight*v/limits.maxLin;
+            if (score > bestScore) {
+                bestScore = score;
+                best = pair<double,double>(v, (a - angCount/2)*limits.angStep);
+            }
+        }
+    }
+    return best;
+}
@@ -0,0 +1,84 @@
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include <waypoint_path.h>
+
+using namespace std;
+
+WaypointPath::WaypointPath(const vector<pair<double,double> >& p_points):
+    points(p_points),
+    arc(p_points.size(), 0),
+    cursor(0),
+    progress(0) {
+    for (size_t i = 1; i < points.size(); i++) {
+        arc[i] = arc[i-1] + hypot(points[i].first - points[i-1].first, points[i].second - points[i-1].second);
+    }
+}
+
+void WaypointPath::clear() {
+    points.clear();
+    arc.clear();
+    cursor = 0;
+    progress = 0;
+}
+
+double WaypointPath::advance(double x, double y, double window) {
+
+    if (points.empty()) {
+        return 0;
+    }
+    if (points.size() == 1) {
+        return hypot(x - points[0].first, y - points[0].second);
+    }
+
+    // closest projection on the segments of the window, the earliest one on a tie
+    double bestDistance = -1;
+    size_t bestSegment = cursor;
+    double bestArc = progress;
+    for (size_t k = cursor; k + 1 < points.size() && arc[k] <= progress + window; k++) {
+        double dx = points[k+1].first - points[k].first;
+        double dy = points[k+1].second - points[k].second;
+        double segment = arc[k+1] - arc[k];
+        double t = 0;
+        if (segment > 0) {
+            t = ((x - points[k].first)*dx + (y - points[k].second)*dy)/(segment*segment);
+            t = min(1.0, max(0.0, t));
+        }
+        double px = points[k].first + t*dx;
+        double py = points[k].second + t*dy;
+        double distance = hypot(x - px, y - py);
+        if (bestDistance < 0 || distance < bestDistance) {
+            bestDistance = distance;
+            bestSegment = k;
+            bestArc = arc[k] + t*segment;
+        }
+    }
+
+    // the progress never goes back
+    if (bestArc > progress) {
+        cursor = bestSegment;
+        progress = bestArc;
+    }
+    return bestDistance;
+}
+
+pair<double,double> WaypointPath::carrot(double lookahead) const {
+
+    if (points.empty()) {
+        return pair<double,double>(0, 0);
+    }
+    double s = progress + lookahead;
+    if (s >= length()) {
+        return points.back();
+    }
+    size_t k = cursor;
+    while (k + 2 < points.size() && arc[k+1] < s) {
+        k++;
+    }
+    double segment = arc[k+1] - arc[k];
+    double t = (segment > 0) ? (s - arc[k])/segment : 0;
+    t = min(1.0, max(0.0, t));
+    return pair<double,double>(points[k].first + t*(points[k+1].first - points[k].first),
+                               points[k].second + t*(points[k+1].second - points[k].second));
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+
+#include <local_path_planner.h>
+
+// Fills the buffers addRobotRadius reads and compares its result with the
+// loop that stamped a window around every obstacle bin before the sweeps.
+struct RobotRadiusTest {
+
+    template <int Bins>
+    static void randomScan(PolarLocalPathPlanner<Bins>& lpp, mt19937& generator, double density) {
+        uniform_real_distribution<double> unit(0, 1);
+        uniform_real_distribution<double> range(0.1, 3.0);
+        for (int i = 0; i < Bins; i++) {
+            lpp.filtered[i] = (unit(generator) < density) ? unit(generator) : 0;
+            lpp.distance[i] = (unit(generator) < 0.8) ? range(generator) : 0;
+            lpp.distanceDepth[i] = (unit(generator) < 0.2) ? range(generator) : 0;
+        }
+    }
+
+    template <int Bins>
+    static vector<float> dilate(PolarLocalPathPlanner<Bins>& lpp, double rad) {
+        vector<float> localMap;
+        lpp.addRobotRadius(rad, localMap);
+        return localMap;
+    }
+
+    template <int Bins>
+    static vector<float> stamp(const PolarLocalPathPlanner<Bins>& lpp, double rad) {
+        double robotRad = lpp.robotRad;
+        vector<float> localMap(lpp.filtered.begin(), lpp.filtered.end());
+        for (int i = 0; i < Bins; i++) {
+            if (lpp.filtered[i] > 0) {
+
+                double d = rad;
+                if (lpp.distance[i]>0) {
+                    d = lpp.distance[i];
+                }
+                if (lpp.distanceDepth[i]>0) {
+                    d = min(d,(double)lpp.distanceDepth[i]);
+                }
+                int angAddMax = (asin((robotRad)/max(d,robotRad))/2.0/M_PI*Bins);
+                int angAddMin = (asin((robotRad-0.05)/max(d,robotRad-0.05))/2.0/M_PI*Bins);
+                for (int di = -angAddMax; di < angAddMax+1; di++) {
+                    int j = (i + di + Bins)%Bins;
+                    float value;
+                    if (abs(di) <= angAddMin) {
+                        value = 1;
+                    } else {
+                        value = (angAddMax + 1 - abs(di))/(float)(angAddMax+1-angAddMin);
+                    }
+                    localMap[j] = max(localMap[j],value);
+                }
+            }
+        }
+        return localMap;
+    }
+
+    template <int Bins>
+    static void compare(double robotRad, int scans, unsigned int seed) {
+        PolarLocalPathPlanner<Bins> lpp(robotRad, 0.5);
+        mt19937 generator(seed);
+        uniform_real_distribution<double> density(0.005, 0.3);
+        uniform_real_distribution<double> rad(0.15, 1.0);
+        for (int k = 0; k < scans; k++) {
+            randomScan(lpp, generator, density(generator));
+            double r = rad(generator);
+            vector<float> expected = stamp(lpp, r);
+            vector<float> actual = dilate(lpp, r);
+            ASSERT_EQ(expected.size(), actual.size());
+            for (int i = 0; i < Bins; i++) {
+                ASSERT_EQ(expected[i], actual[i]) << "bin " << i << " of scan " << k << " (" << Bins << " bins)";
+            }
+        }
+    }
+};
+
+TEST(RobotRadius, MatchesStamping360) {
+    RobotRadiusTest::compare<360>(0.18, 20000, 1);
+    RobotRadiusTest::compare<360>(0.25, 5000, 2);
+}
+
+TEST(RobotRadius, MatchesStamping720) {
+    RobotRadiusTest::compare<720>(0.18, 5000, 3);
+}
+
+TEST(RobotRadius, MatchesStamping1440) {
+    RobotRadiusTest::compare<1440>(0.18, 2000, 4);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
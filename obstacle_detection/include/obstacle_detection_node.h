@@ -0,0 +1,12 @@
+#ifndef OBSTACLE_DETECTION_NODE_H
+#define OBSTACLE_DETECTION_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Bins the depth camera points into /depth until ROS shuts down or running is cleared,
+// queue holds the callbacks of n and is served by the node loop.
+void runObstacleDetectionNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // OBSTACLE_DETECTION_NODE_H
@@ -17,6 +17,11 @@
 #include <pcl/filters/voxel_grid.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>
+#include <ros/callback_queue.h>
+#include <boost/make_shared.hpp>
+#include <atomic>
+
+#include <obstacle_detection_node.h>
 
 class ObstaclePublisher
 {
@@ -75,9 +80,9 @@ public:
 
   ros::Time cloud_time;
 
-  ObstaclePublisher()
+  ObstaclePublisher(ros::NodeHandle& nh)
   {
-    n = ros::NodeHandle("~");
+    n = nh;
 
     sub = n.subscribe("/camera/depth/points", 1, &ObstaclePublisher::pointCloudCallback, this);
 
@@ -481,15 +486,12 @@ private:
   std::vector<float> distances;
 };
 
-int main(int argc, char **argv)
+void runObstacleDetectionNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running)
 {
 
   ROS_INFO("Spinning!");
 
-  // Initialize ROS
-  ros::init(argc, argv, "obstacle_detection");
-
-  ObstaclePublisher obs;
+  ObstaclePublisher obs(n);
   ros::Rate loop_rate(10);
 
   // Create a ROS publisher for the output point cloud
@@ -501,9 +503,9 @@ int main(int argc, char **argv)
   tf::TransformListener listener;
 
   int count = 0;
-  while (obs.n.ok())
+  while (obs.n.ok() && running)
   {
-    ros::spinOnce();
+    queue.callAvailable();
 
     if(obs.point_cloud_received) {
       // Transform cloud
@@ -524,9 +526,11 @@ int main(int argc, char **argv)
         }
       }
 
-      pub.publish(obs.transformed_pc);
+      // messages go out as pointers, nodelets in the same manager receive them without a copy,
+      // the cloud is moved out, the next one is transformed into a new message
+      pub.publish(boost::make_shared<sensor_msgs::PointCloud2>(std::move(obs.transformed_pc)));
 
-      obstacle_publisher.publish(obs.obstacles_found);
+      obstacle_publisher.publish(boost::make_shared<project_msgs::depth>(obs.obstacles_found));
 
       
       if(obs.angular_vel < obs.ANGULAR_VELOCITY_THRESHOLD && obs.SEND_BATTERIES_WALLS) {
@@ -537,6 +541,4 @@ int main(int argc, char **argv)
     loop_rate.sleep();
     ++count;
   }
-
-  return 0;
 }
@@ -0,0 +1,16 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <atomic>
+
+#include <obstacle_detection_node.h>
+
+int main(int argc, char **argv) {
+
+  ros::init(argc, argv, "obstacle_detection");
+
+  ros::NodeHandle n("~");
+  std::atomic<bool> running(true);
+  runObstacleDetectionNode(n, *ros::getGlobalCallbackQueue(), running);
+
+  return 0;
+}
@@ -0,0 +1,42 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <atomic>
+#include <thread>
+
+#include <obstacle_detection_node.h>
+
+namespace obstacle_detection {
+
+// obstacle_detection_node in a nodelet manager. Point clouds and /filter
+// published in the same manager arrive as shared pointers, the node loop
+// and its callbacks run on a thread of their own.
+class ObstacleDetectionNodelet : public nodelet::Nodelet {
+public:
+  ObstacleDetectionNodelet(): running(false) {};
+  ~ObstacleDetectionNodelet() {
+    running = false;
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+
+private:
+  ros::CallbackQueue queue;
+  std::atomic<bool> running;
+  std::thread worker;
+
+  virtual void onInit() {
+    ros::NodeHandle n = getNodeHandle();
+    n.setCallbackQueue(&queue);
+    running = true;
+    worker = std::thread([this, n]() mutable {
+      runObstacleDetectionNode(n, queue, running);
+    });
+  }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(obstacle_detection::ObstacleDetectionNodelet, nodelet::Nodelet)
@@ -0,0 +1,12 @@
+#ifndef ODOMETRY_NODE_H
+#define ODOMETRY_NODE_H 1
+
+#include <atomic>
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+
+// Integrates the wheel encoders until ROS shuts down or running is cleared.
+// Callbacks of n are served from queue between the integration steps.
+void runOdometryNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running);
+
+#endif // ODOMETRY_NODE_H
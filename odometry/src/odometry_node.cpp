@@ -4,6 +4,11 @@
 #include <tf/transform_broadcaster.h>
 #include <math.h>
 #include <std_msgs/Bool.h>
+#include <ros/callback_queue.h>
+#include <boost/make_shared.hpp>
+#include <atomic>
+
+#include <odometry_node.h>
 
 
 
@@ -31,9 +36,9 @@ public:
     bool _update_position;
 
 
-OdometryPublisher(int frequency){
+OdometryPublisher(ros::NodeHandle& nh, int frequency){
     control_frequency = frequency;
-    n = ros::NodeHandle("~");
+    n = nh;
     pi = 3.1416;
     xpos = 0.215;
     ypos = 0.230;
@@ -195,7 +200,8 @@ void calculateNewPosition(){
     odom_msg.twist.twist.linear.y = vy;
     odom_msg.twist.twist.angular.z = angular_w;
 
-    odom_publisher.publish(odom_msg);
+    // shared with the nodelets of the same manager, not serialised for them
+    odom_publisher.publish(boost::make_shared<nav_msgs::Odometry>(odom_msg));
 
 }
 private:
@@ -210,32 +216,28 @@ private:
 };
 
 
-int main(int argc, char **argv)
+void runOdometryNode(ros::NodeHandle& n, ros::CallbackQueue& queue, const std::atomic<bool>& running)
 {
 
   double frequency = 100;
-  ros::init(argc, argv, "odometry_publisher");
 
-  OdometryPublisher odom(frequency);
+  OdometryPublisher odom(n, frequency);
 
   ROS_INFO("Spin!");
 
   ros::Rate loop_rate(frequency);
 
   int count = 0;
-  while (odom.n.ok()){
+  while (odom.n.ok() && running){
       if(odom._update_position){
           odom.updatePositionAccordingToFilter();
       }
 
     odom.calculateNewPosition();
-    ros::spinOnce();
+    queue.callAvailable();
 
     loop_rate.sleep();
     ++count;
   }
-
-
-  return 0;
 }
 
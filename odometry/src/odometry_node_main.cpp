@@ -0,0 +1,16 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <atomic>
+
+#include <odometry_node.h>
+
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "odometry_publisher");
+
+    ros::NodeHandle n("~");
+    std::atomic<bool> running(true);
+    runOdometryNode(n, *ros::getGlobalCallbackQueue(), running);
+
+    return 0;
+}
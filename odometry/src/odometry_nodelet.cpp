@@ -0,0 +1,41 @@
+#include "ros/ros.h"
+#include <ros/callback_queue.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <atomic>
+#include <thread>
+
+#include <odometry_node.h>
+
+namespace odometry {
+
+// odometry_node in a nodelet manager, the 100 Hz loop keeps a thread
+// and a callback queue of its own.
+class OdometryNodelet : public nodelet::Nodelet {
+public:
+    OdometryNodelet(): running(false) {};
+    ~OdometryNodelet() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+private:
+    ros::CallbackQueue queue;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    virtual void onInit() {
+        ros::NodeHandle n = getPrivateNodeHandle();
+        n.setCallbackQueue(&queue);
+        running = true;
+        worker = std::thread([this, n]() mutable {
+            runOdometryNode(n, queue, running);
+        });
+    }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(odometry::OdometryNodelet, nodelet::Nodelet)